@@ -0,0 +1,75 @@
+#include "Instrumentation/CCACandidateIndex.hpp"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Module.h"
+#include <iterator>
+
+namespace llvm {
+namespace cca {
+
+//-------------------------------------
+// Class: CCA Candidate Index
+//-------------------------------------
+// The Value of a Store may be Read before a Later Store Overwrites it (an unwinding call lets its caller read memory).
+// Calls accessing only memory inaccessible to the module, such as the cca pseudo-intrinsics of earlier rules, cannot read it.
+static bool mayObserve(const Instruction &I) {
+	if (I.mayThrow()) return true;
+	if (isa<CallBase>(I) && cast<CallBase>(I).onlyAccessesInaccessibleMemory()) return false;
+	return I.mayReadFromMemory();
+}
+
+// A Later Store to the Same Pointer Overwrites a (Removable) Store if it is at least as Large
+static bool overwrites(const StoreInst *Later, const StoreInst *S) {
+	if (!S->isSimple() || Later->getPointerOperand() != S->getPointerOperand()) return false;
+	const DataLayout &DL = S->getModule()->getDataLayout();
+	TypeSize LaterSize = DL.getTypeStoreSize(Later->getValueOperand()->getType()), Size = DL.getTypeStoreSize(S->getValueOperand()->getType());
+	return !LaterSize.isScalable() && !Size.isScalable() && LaterSize.getFixedSize() >= Size.getFixedSize();
+}
+
+// Constructor
+CCACandidateIndex::CCACandidateIndex(Function &F) : index_(), nextstore_(), empty_() {
+	for (BasicBlock &BB : F) {
+		BlockIndex &BI = index_[&BB];
+		for (Instruction &I : BB) BI[{I.getOpcode(), I.getType()}].push_back(&I);
+		// Link Each Store to the Next Store to the Same Pointer (Scanning Backward, and Forgetting the Stores after a Read)
+		DenseMap<Value *, StoreInst *> LastStore;
+		for (auto BBIter = BB.rbegin(); BBIter != BB.rend(); ++BBIter) {
+			if (mayObserve(*BBIter)) LastStore.clear();
+			if (!isa<StoreInst>(&*BBIter)) continue;
+			StoreInst *S = cast<StoreInst>(&*BBIter);
+			StoreInst *&Last = LastStore[S->getPointerOperand()];
+			if (Last != nullptr && overwrites(Last, S)) nextstore_[S] = Last;
+			Last = S;
+		}
+	}
+}
+
+StoreInst *CCACandidateIndex::findNextStore(StoreInst *S) {
+	for (auto BBIter = std::next(S->getIterator()); BBIter != S->getParent()->end(); ++BBIter) {
+		StoreInst *Later = dyn_cast<StoreInst>(&*BBIter);
+		if (Later != nullptr && Later->getPointerOperand() == S->getPointerOperand()) return overwrites(Later, S) ? Later : nullptr;
+		if (mayObserve(*BBIter)) return nullptr;
+	}
+	return nullptr;
+}
+
+// Get Instructions with Opcode and Type in Basic Block
+const std::vector<Instruction *> &CCACandidateIndex::get(const BasicBlock *BB, unsigned opcode, Type *Ty) const {
+	auto BlockIter = index_.find(BB);
+	if (BlockIter == index_.end()) return empty_;
+	auto BucketIter = BlockIter->second.find({opcode, Ty});
+	if (BucketIter == BlockIter->second.end()) return empty_;
+	return BucketIter->second;
+}
+
+//-------------------------------------
+// Class: CCA Candidate Index Analysis
+//-------------------------------------
+AnalysisKey CCACandidateIndexAnalysis::Key;
+
+CCACandidateIndexAnalysis::Result CCACandidateIndexAnalysis::run(Function &F, FunctionAnalysisManager &) { return CCACandidateIndex(F); }
+
+} // namespace cca
+} // namespace llvm
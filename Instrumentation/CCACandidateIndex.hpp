@@ -0,0 +1,52 @@
+#ifndef PIMCCALLVMPASS_INSTRUMENTATION_CCA_CANDIDATE_INDEX_HPP_
+#define PIMCCALLVMPASS_INSTRUMENTATION_CCA_CANDIDATE_INDEX_HPP_
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/PassManager.h"
+#include <utility>
+#include <vector>
+
+namespace llvm {
+namespace cca {
+
+//-------------------------------------
+// Class: CCA Candidate Index
+//-------------------------------------
+// Instructions of each basic block bucketed by (opcode, type) in program order,
+// and the next store to the same pointer in the block of each store which overwrites it: it is at least as large,
+// and no instruction between them may read memory or unwind. The pass rebuilds the index after each rule which
+// rewrites the function.
+class CCACandidateIndex {
+  private:
+	typedef DenseMap<std::pair<unsigned, Type *>, std::vector<Instruction *>> BlockIndex;
+	DenseMap<const BasicBlock *, BlockIndex> index_;
+	DenseMap<const StoreInst *, StoreInst *> nextstore_;
+	const std::vector<Instruction *> empty_;
+
+  public:
+	CCACandidateIndex(Function &F);
+	const std::vector<Instruction *> &get(const BasicBlock *BB, unsigned opcode, Type *Ty) const;
+	StoreInst *getNextStore(const StoreInst *S) const { return nextstore_.lookup(S); }
+	// Scan for the Next Store Overwriting a Store (without an index)
+	static StoreInst *findNextStore(StoreInst *S);
+};
+
+//-------------------------------------
+// Class: CCA Candidate Index Analysis
+//-------------------------------------
+class CCACandidateIndexAnalysis : public AnalysisInfoMixin<CCACandidateIndexAnalysis> {
+  private:
+	friend AnalysisInfoMixin<CCACandidateIndexAnalysis>;
+	static AnalysisKey Key;
+
+  public:
+	typedef CCACandidateIndex Result;
+	Result run(Function &F, FunctionAnalysisManager &);
+};
+
+} // namespace cca
+} // namespace llvm
+
+#endif // PIMCCALLVMPASS_INSTRUMENTATION_CCA_CANDIDATE_INDEX_HPP_
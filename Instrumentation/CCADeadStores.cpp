@@ -0,0 +1,103 @@
+#include "Instrumentation/CCADeadStores.hpp"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/CaptureTracking.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/CFG.h"
+#include <vector>
+
+namespace llvm {
+namespace cca {
+
+// Bound of the accesses visited for a store (a store reaching more is kept)
+static const unsigned CCADeadStoreWalkLimit = 64;
+
+//-------------------------------------
+// Class: CCA Dead Stores
+//-------------------------------------
+// Constructor (the Stores of the Values a Rule may Match are Answered, as only they can Use Matched Codes)
+CCADeadStores::CCADeadStores(Function &F, AAResults &AA, DominatorTree &DT, PostDominatorTree &PDT) : AA_(AA), PDT_(PDT), dead_() {
+	std::vector<StoreInst *> Stores;
+	for (BasicBlock &BB : F)
+		for (Instruction &I : BB)
+			if (isa<StoreInst>(&I)) {
+				Value *V = cast<StoreInst>(&I)->getValueOperand();
+				if (isa<BinaryOperator>(V) || isa<ICmpInst>(V) || isa<SelectInst>(V)) Stores.push_back(cast<StoreInst>(&I));
+			}
+	if (Stores.empty()) return;
+	MemorySSA MSSA(F, &AA, &DT);
+	for (StoreInst *S : Stores)
+		if (compute(MSSA, S)) dead_[S] = true;
+}
+
+// Check a Store Overwrites the Whole Location
+bool CCADeadStores::isKilling(const StoreInst *K, const MemoryLocation &Loc) const {
+	MemoryLocation KLoc = MemoryLocation::get(K);
+	if (!KLoc.Size.hasValue() || !Loc.Size.hasValue() || KLoc.Size.getValue() < Loc.Size.getValue()) return false;
+	return AA_.isMustAlias(KLoc, Loc);
+}
+
+// Check an Instruction may Throw on a Path from a Store to its Killing Store (an unwinding path skips the killing store,
+// and has no MemorySSA access if the instruction does not touch memory)
+static bool mayThrowBetween(const StoreInst *S, const Instruction *K) {
+	const BasicBlock *SBB = S->getParent(), *KBB = K->getParent();
+	for (const Instruction *I = S->getNextNode(); I != nullptr && I != K; I = I->getNextNode())
+		if (I->mayThrow()) return true;
+	if (SBB == KBB) return false;
+	// Blocks of the Paths until the Block of the Killing Store (the store's block again, with a loop, as a whole)
+	SmallVector<const BasicBlock *, 16> Work(succ_begin(SBB), succ_end(SBB));
+	SmallPtrSet<const BasicBlock *, 16> Visited;
+	while (!Work.empty()) {
+		const BasicBlock *BB = Work.pop_back_val();
+		if (!Visited.insert(BB).second) continue;
+		if (Visited.size() > CCADeadStoreWalkLimit) return true;
+		for (const Instruction &I : *BB) {
+			if (&I == K) break;
+			if (I.mayThrow()) return true;
+		}
+		if (BB != KBB) Work.append(succ_begin(BB), succ_end(BB));
+	}
+	return false;
+}
+
+// Walk the MemorySSA Users of a Store until Killing Stores
+bool CCADeadStores::compute(MemorySSA &MSSA, StoreInst *S) const {
+	if (!S->isSimple()) return false;
+	MemoryAccess *MA = MSSA.getMemoryAccess(S);
+	if (MA == nullptr) return false;
+	MemoryLocation Loc = MemoryLocation::get(S);
+	// A local object which does not escape cannot be read after an unwinding
+	const Value *Obj = getUnderlyingObject(Loc.Ptr);
+	const bool local = isa<AllocaInst>(Obj) && !PointerMayBeCaptured(Obj, true, true);
+	bool killed = false;
+	SmallVector<MemoryAccess *, 16> Work;
+	SmallPtrSet<MemoryAccess *, 16> Visited;
+	for (User *U : MA->users()) Work.push_back(cast<MemoryAccess>(U));
+	while (!Work.empty()) {
+		MemoryAccess *UA = Work.pop_back_val();
+		if (!Visited.insert(UA).second) continue;
+		if (Visited.size() > CCADeadStoreWalkLimit) return false;
+		// Paths Merging
+		if (isa<MemoryPhi>(UA)) {
+			for (User *U : UA->users()) Work.push_back(cast<MemoryAccess>(U));
+			continue;
+		}
+		Instruction *I = cast<MemoryUseOrDef>(UA)->getMemoryInst();
+		// Killing Store (the store is dead only if one of them is on every path)
+		if (isa<StoreInst>(I) && isKilling(cast<StoreInst>(I), Loc)) {
+			// (in the same block, by the instruction order, instead of the scan of the block by the post-dominator tree)
+			if (I->getParent() == S->getParent() ? S->comesBefore(I) : PDT_.dominates(I->getParent(), S->getParent()))
+				killed = killed || local || !mayThrowBetween(S, I);
+			continue;
+		}
+		// Reads of the Stored Value
+		if (isRefSet(AA_.getModRefInfo(I, Loc))) return false;
+		if (isa<MemoryDef>(UA))
+			for (User *U : UA->users()) Work.push_back(cast<MemoryAccess>(U));
+	}
+	return killed;
+}
+
+} // namespace cca
+} // namespace llvm
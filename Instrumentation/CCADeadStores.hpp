@@ -0,0 +1,38 @@
+#ifndef PIMCCALLVMPASS_INSTRUMENTATION_CCA_DEAD_STORES_HPP_
+#define PIMCCALLVMPASS_INSTRUMENTATION_CCA_DEAD_STORES_HPP_
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+
+namespace llvm {
+namespace cca {
+
+//-------------------------------------
+// Class: CCA Dead Stores
+//-------------------------------------
+// Stores of intermediate values which can be removed with them: a store is dead if a killing store (must-alias, and
+// at least as large) post-dominates it, and no access on the MemorySSA def-use paths until a killing store may read it.
+// Every store of an instruction is answered when the instance is built (before the matching, which may run on several
+// threads and then only reads the answers), so an instance is valid until the function is rewritten.
+class CCADeadStores final {
+  private:
+	AAResults &AA_;
+	PostDominatorTree &PDT_;
+	DenseMap<const StoreInst *, bool> dead_;
+
+	bool isKilling(const StoreInst *K, const MemoryLocation &Loc) const;
+	bool compute(MemorySSA &MSSA, StoreInst *S) const;
+
+  public:
+	CCADeadStores(Function &F, AAResults &AA, DominatorTree &DT, PostDominatorTree &PDT);
+	bool isDead(const StoreInst *S) const { return dead_.lookup(S); }
+};
+
+} // namespace cca
+} // namespace llvm
+
+#endif // PIMCCALLVMPASS_INSTRUMENTATION_CCA_DEAD_STORES_HPP_
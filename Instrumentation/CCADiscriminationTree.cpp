@@ -0,0 +1,89 @@
+#include "Instrumentation/CCADiscriminationTree.hpp"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Type.h"
+#include <algorithm>
+
+namespace llvm {
+namespace cca {
+
+// Shape Key of an IR Value (CCAShapeAny for the values which can only be registers)
+static CCAShapeKey getShapeKey(Value *V) {
+	if (isa<BinaryOperator>(V)) return makeShapeKey(cast<BinaryOperator>(V)->getOpcode());
+	if (isa<ICmpInst>(V)) return makeShapeKey(Instruction::ICmp, cast<ICmpInst>(V)->getPredicate());
+	if (isa<SelectInst>(V)) return makeShapeKey(Instruction::Select);
+	return CCAShapeAny;
+}
+
+//-------------------------------------
+// Class: CCA Discrimination Tree
+//-------------------------------------
+// Constructor
+CCADiscriminationTree::CCADiscriminationTree(const std::vector<CCAPatternGraphPtr> &Graphs) : nodes_(1), opcodes_(), rules_(Graphs.size()), root_sizes_() {
+	for (unsigned ridx = 0; ridx < Graphs.size(); ++ridx) {
+		root_sizes_.push_back(Graphs[ridx]->root_size());
+		for (unsigned gidx = 0; gidx < Graphs[ridx]->root_size(); ++gidx) {
+			opcodes_.insert(Graphs[ridx]->opcode().at(gidx));
+			for (const CCAShape &Shape : Graphs[ridx]->root_shapes(gidx)) {
+				unsigned node = 0;
+				for (CCAShapeKey key : Shape) {
+					auto iter = nodes_[node].next.find(key);
+					if (iter != nodes_[node].next.end()) node = iter->second;
+					else {
+						nodes_[node].next.insert({key, nodes_.size()});
+						node = nodes_.size();
+						nodes_.emplace_back();
+					}
+				}
+				nodes_[node].roots.push_back({ridx, gidx});
+			}
+		}
+	}
+}
+
+// Walk the Operand Trees of the Pending Values (in preorder) through the Trie
+void CCADiscriminationTree::walk(unsigned node, std::vector<Value *> &Pending, std::vector<std::pair<unsigned, unsigned>> &Found) const {
+	const TrieNode &N = nodes_[node];
+	if (Pending.empty()) {
+		Found.insert(Found.end(), N.roots.begin(), N.roots.end());
+		return;
+	}
+	Value *V = Pending.back();
+	Pending.pop_back();
+	// Any value can be a register
+	auto AnyIter = N.next.find(CCAShapeAny);
+	if (AnyIter != N.next.end()) walk(AnyIter->second, Pending, Found);
+	// Operators continue with their operands
+	CCAShapeKey key = getShapeKey(V);
+	auto KeyIter = key == CCAShapeAny ? N.next.end() : N.next.find(key);
+	if (KeyIter != N.next.end()) {
+		User *U = cast<User>(V);
+		for (unsigned idx = U->getNumOperands(); idx-- > 0;) Pending.push_back(U->getOperand(idx));
+		walk(KeyIter->second, Pending, Found);
+		Pending.resize(Pending.size() - U->getNumOperands());
+	}
+	Pending.push_back(V);
+}
+
+// Classify the Instructions of a Block as Root Candidates of All Rules
+void CCADiscriminationTree::classify(BasicBlock &BB, const CCACandidateIndex &Index, std::vector<CCARootCandidates> &Roots) const {
+	Roots.assign(rules_, CCARootCandidates());
+	for (unsigned ridx = 0; ridx < rules_; ++ridx) Roots[ridx].resize(root_sizes_[ridx]);
+	// Output roots are always 32-bit registers
+	Type *Int32Ty = Type::getInt32Ty(BB.getContext());
+	std::vector<Value *> Pending;
+	std::vector<std::pair<unsigned, unsigned>> Found;
+	for (unsigned opcode : opcodes_) {
+		for (Instruction *I : Index.get(&BB, opcode, Int32Ty)) {
+			Pending.assign(1, I);
+			Found.clear();
+			walk(0, Pending, Found);
+			std::sort(Found.begin(), Found.end());
+			Found.erase(std::unique(Found.begin(), Found.end()), Found.end());
+			for (auto &RootIter : Found) Roots[RootIter.first][RootIter.second].push_back(I);
+		}
+	}
+}
+
+} // namespace cca
+} // namespace llvm
@@ -0,0 +1,45 @@
+#ifndef PIMCCALLVMPASS_INSTRUMENTATION_CCA_DISCRIMINATION_TREE_HPP_
+#define PIMCCALLVMPASS_INSTRUMENTATION_CCA_DISCRIMINATION_TREE_HPP_
+
+#include "Instrumentation/CCACandidateIndex.hpp"
+#include "Instrumentation/CCAPatternGraph.hpp"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instruction.h"
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+namespace cca {
+
+// Root candidates of a rule in a basic block, per output root (in program order)
+typedef std::vector<std::vector<Instruction *>> CCARootCandidates;
+
+//-------------------------------------
+// Class: CCA Discrimination Tree
+//-------------------------------------
+// Trie over the root shapes of all rules: each instruction is walked once through the trie along its operand tree,
+// taking both the edge of its own opcode and the wildcard edge of registers, and every (rule, root) reached is reported
+class CCADiscriminationTree final {
+  private:
+	struct TrieNode {
+		std::map<CCAShapeKey, unsigned> next;
+		std::vector<std::pair<unsigned, unsigned>> roots; // (rule, root) whose shape ends here
+	};
+	std::vector<TrieNode> nodes_;
+	std::set<unsigned> opcodes_; // opcodes of all roots
+	unsigned rules_;
+	std::vector<unsigned> root_sizes_;
+
+	void walk(unsigned node, std::vector<Value *> &Pending, std::vector<std::pair<unsigned, unsigned>> &Found) const;
+
+  public:
+	CCADiscriminationTree(const std::vector<CCAPatternGraphPtr> &Graphs);
+	void classify(BasicBlock &BB, const CCACandidateIndex &Index, std::vector<CCARootCandidates> &Roots) const;
+};
+
+} // namespace cca
+} // namespace llvm
+
+#endif // PIMCCALLVMPASS_INSTRUMENTATION_CCA_DISCRIMINATION_TREE_HPP_
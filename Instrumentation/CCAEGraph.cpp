@@ -0,0 +1,227 @@
+#include "Instrumentation/CCAEGraph.hpp"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instructions.h"
+
+namespace llvm {
+namespace cca {
+
+//-------------------------------------
+// Class: CCA E-Graph
+//-------------------------------------
+CCAEGraphConstants getEGraphConstants(LLVMContext &Context) {
+	CCAEGraphConstants Constants;
+	for (unsigned exponent = 0; exponent < Constants.size(); ++exponent)
+		Constants[exponent] = ConstantInt::get(Type::getInt32Ty(Context), (uint64_t)1 << exponent);
+	return Constants;
+}
+
+// Constructor (Add the Values of the Block, then Rewrite until Saturated or Limited)
+CCAEGraph::CCAEGraph(BasicBlock &BB, const CCAEGraphConstants &Constants, unsigned nodelimit, unsigned iterlimit)
+	: BB_(BB), Constants_(Constants), parent_(), leader_(), nodes_(), nodeclass_(), hashcons_(), classof_(), members_(), nodelimit_(0), merges_(0) {
+	for (Instruction &I : BB)
+		if (!I.getType()->isVoidTy()) addValue(&I);
+	rebuild();
+	nodelimit_ = nodes_.size() + nodelimit;
+	for (unsigned iter = 0; iter < iterlimit && nodes_.size() < nodelimit_; ++iter) {
+		// Nodes and classes found by an iteration are visible from the next one
+		std::vector<unsigned> Canonical = collect();
+		unsigned nodecount = nodes_.size(), merges = merges_;
+		for (unsigned n : Canonical) rewrite(n);
+		rebuild();
+		if (nodes_.size() == nodecount && merges_ == merges) break;
+	}
+	collect();
+}
+
+// Collect the Nodes of Each Class (a Node Congruent to an Earlier One is Skipped)
+std::vector<unsigned> CCAEGraph::collect(void) {
+	std::vector<unsigned> Canonical;
+	members_.assign(parent_.size(), std::vector<unsigned>());
+	for (unsigned n = 0; n < nodes_.size(); ++n) {
+		auto HashIter = hashcons_.find(key(nodes_[n]));
+		if (HashIter == hashcons_.end() || HashIter->second != n) continue;
+		Canonical.push_back(n);
+		members_[find(nodeclass_[n])].push_back(n);
+	}
+	return Canonical;
+}
+
+// Union-Find
+unsigned CCAEGraph::find(unsigned cls) const {
+	while (parent_[cls] != cls) {
+		parent_[cls] = parent_[parent_[cls]];
+		cls = parent_[cls];
+	}
+	return cls;
+}
+
+// The earlier class is kept, so the leader is the earliest value
+bool CCAEGraph::merge(unsigned a, unsigned b) {
+	a = find(a);
+	b = find(b);
+	if (a == b) return false;
+	if (b < a) std::swap(a, b);
+	parent_[b] = a;
+	if (leader_[a] == nullptr) leader_[a] = leader_[b];
+	++merges_;
+	return true;
+}
+
+CCAEGraph::NodeKey CCAEGraph::key(const CCAENode &N) const {
+	NodeKey K = {N.opcode, N.pred, None, None, None};
+	for (unsigned idx = 0; idx < N.size; ++idx) K[2 + idx] = find(N.ops[idx]);
+	return K;
+}
+
+// Restore Congruence: Nodes which became the Same after Merging Merge their Classes
+void CCAEGraph::rebuild(void) {
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		hashcons_.clear();
+		for (unsigned n = 0; n < nodes_.size(); ++n) {
+			auto Ins = hashcons_.insert({key(nodes_[n]), n});
+			if (!Ins.second && merge(nodeclass_[Ins.first->second], nodeclass_[n])) changed = true;
+		}
+	}
+}
+
+unsigned CCAEGraph::newClass(Value *V) {
+	parent_.push_back(parent_.size());
+	leader_.push_back(V);
+	if (V != nullptr) classof_[V] = parent_.size() - 1;
+	return parent_.size() - 1;
+}
+
+unsigned CCAEGraph::addNode(CCAENode N, unsigned cls) {
+	auto HashIter = hashcons_.find(key(N));
+	if (HashIter != hashcons_.end()) {
+		merge(nodeclass_[HashIter->second], cls);
+		return HashIter->second;
+	}
+	nodes_.push_back(N);
+	nodeclass_.push_back(cls);
+	hashcons_[key(N)] = nodes_.size() - 1;
+	return nodes_.size() - 1;
+}
+
+// Add a Value (Instructions of the Block become Nodes over the Classes of their Operands)
+unsigned CCAEGraph::addValue(Value *V) {
+	auto ClassIter = classof_.find(V);
+	if (ClassIter != classof_.end()) return find(ClassIter->second);
+	CCAENode N = {0, 0, 0, {None, None, None}};
+	Instruction *I = dyn_cast<Instruction>(V);
+	if (I != nullptr && I->getParent() == &BB_) {
+		if (isa<BinaryOperator>(I) && I->getType()->isIntegerTy(32)) N = {I->getOpcode(), 0, 2, {None, None, None}};
+		else if (isa<ICmpInst>(I) && I->getOperand(0)->getType()->isIntegerTy(32))
+			N = {I->getOpcode(), (unsigned)cast<ICmpInst>(I)->getPredicate(), 2, {None, None, None}};
+		else if (isa<SelectInst>(I) && I->getType()->isIntegerTy(32))
+			N = {I->getOpcode(), 0, 3, {None, None, None}};
+	}
+	for (unsigned idx = 0; idx < N.size; ++idx) N.ops[idx] = addValue(I->getOperand(idx));
+	unsigned cls = newClass(V);
+	if (N.size != 0) addNode(N, cls);
+	return find(cls);
+}
+
+// Get the Class of a Binary Node, Creating it (with no Value) unless the Node Limit is Reached
+unsigned CCAEGraph::getNode(unsigned opcode, unsigned lhs, unsigned rhs) {
+	if (lhs == None || rhs == None) return None;
+	CCAENode N = {opcode, 0, 2, {find(lhs), find(rhs), None}};
+	auto HashIter = hashcons_.find(key(N));
+	if (HashIter != hashcons_.end()) return find(nodeclass_[HashIter->second]);
+	if (nodes_.size() >= nodelimit_) return None;
+	unsigned cls = newClass(nullptr);
+	addNode(N, cls);
+	return find(cls);
+}
+
+unsigned CCAEGraph::getPowerOfTwo(unsigned exponent) { return addValue(Constants_[exponent]); }
+
+// Apply the Rewrites to a Node
+void CCAEGraph::rewrite(unsigned n) {
+	const CCAENode N = nodes_[n];
+	unsigned cls = nodeclass_[n];
+	static const std::vector<unsigned> NoMembers;
+	auto Members = [this](unsigned c) -> const std::vector<unsigned> & { return find(c) < members_.size() ? members_[find(c)] : NoMembers; };
+	switch (N.opcode) {
+	case Instruction::Shl: {
+		// x << C => x * 2^C
+		ConstantInt *C = dyn_cast_or_null<ConstantInt>(leader(N.ops[1]));
+		if (C != nullptr && C->getZExtValue() < 32) {
+			unsigned m = getNode(Instruction::Mul, N.ops[0], getPowerOfTwo(C->getZExtValue()));
+			if (m != None) merge(cls, m);
+		}
+		break;
+	}
+	case Instruction::Add:
+		// a + (0 - b) => a - b
+		for (unsigned side = 0; side < 2; ++side) {
+			for (unsigned m : Members(N.ops[1 - side])) {
+				const CCAENode Neg = nodes_[m];
+				ConstantInt *Zero = dyn_cast_or_null<ConstantInt>(leader(Neg.ops[0]));
+				if (Neg.opcode != Instruction::Sub || Zero == nullptr || !Zero->isZero()) continue;
+				unsigned s = getNode(Instruction::Sub, N.ops[side], Neg.ops[1]);
+				if (s != None) merge(cls, s);
+			}
+		}
+		LLVM_FALLTHROUGH;
+	case Instruction::Sub:
+		// x * a + x * b => x * (a + b), and the same for sub
+		for (unsigned p : Members(N.ops[0])) {
+			if (nodes_[p].opcode != Instruction::Mul) continue;
+			for (unsigned q : Members(N.ops[1])) {
+				if (nodes_[q].opcode != Instruction::Mul) continue;
+				const CCAENode P = nodes_[p], Q = nodes_[q];
+				for (unsigned i = 0; i < 2; ++i)
+					for (unsigned j = 0; j < 2; ++j) {
+						if (find(P.ops[i]) != find(Q.ops[j])) continue;
+						unsigned f = getNode(Instruction::Mul, P.ops[i], getNode(N.opcode, P.ops[1 - i], Q.ops[1 - j]));
+						if (f != None) merge(cls, f);
+					}
+			}
+		}
+		break;
+	case Instruction::Mul:
+		// x * (a + b) => x * a + x * b, and the same for sub
+		for (unsigned side = 0; side < 2; ++side) {
+			for (unsigned s : Members(N.ops[1 - side])) {
+				const CCAENode S = nodes_[s];
+				if (S.opcode != Instruction::Add && S.opcode != Instruction::Sub) continue;
+				unsigned d = getNode(S.opcode, getNode(Instruction::Mul, N.ops[side], S.ops[0]), getNode(Instruction::Mul, N.ops[side], S.ops[1]));
+				if (d != None) merge(cls, d);
+			}
+		}
+		break;
+	default: break;
+	}
+}
+
+// Get the Class of a Value
+unsigned CCAEGraph::classOf(Value *V) const {
+	auto ClassIter = classof_.find(V);
+	return ClassIter == classof_.end() ? None : find(ClassIter->second);
+}
+
+// Check the Class of a Value has a Node of the Opcode
+bool CCAEGraph::hasNode(Value *V, unsigned opcode) const {
+	unsigned cls = classOf(V);
+	if (cls == None) return false;
+	for (unsigned n : members(cls))
+		if (nodes_[n].opcode == opcode) return true;
+	return false;
+}
+
+// Classify the Root Candidates of a Rule: the i32 instructions whose class has the opcode of the root
+void CCAEGraph::classify(const std::vector<unsigned> &opcodes, std::vector<std::vector<Instruction *>> &Roots) const {
+	Roots.assign(opcodes.size(), std::vector<Instruction *>());
+	for (Instruction &I : BB_) {
+		if (!I.getType()->isIntegerTy(32)) continue;
+		for (unsigned gidx = 0; gidx < opcodes.size(); ++gidx)
+			if (hasNode(&I, opcodes[gidx])) Roots[gidx].push_back(&I);
+	}
+}
+
+} // namespace cca
+} // namespace llvm
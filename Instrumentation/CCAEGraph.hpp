@@ -0,0 +1,81 @@
+#ifndef PIMCCALLVMPASS_INSTRUMENTATION_CCA_EGRAPH_HPP_
+#define PIMCCALLVMPASS_INSTRUMENTATION_CCA_EGRAPH_HPP_
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instruction.h"
+#include <array>
+#include <map>
+#include <vector>
+
+namespace llvm {
+namespace cca {
+
+//-------------------------------------
+// Struct: CCA E-Node
+//-------------------------------------
+// Operation over equivalence classes: a binary operator, an icmp (with its predicate) or a select
+struct CCAENode {
+	unsigned opcode;
+	unsigned pred;
+	unsigned size;
+	unsigned ops[3];
+};
+
+// Constants Created by the Rewrites (the powers of two of a shl), Interned in the LLVM Context before the Search:
+// the e-graphs are built on the threads of the module pass, which only read the context
+typedef std::array<ConstantInt *, 32> CCAEGraphConstants;
+CCAEGraphConstants getEGraphConstants(LLVMContext &Context);
+
+//-------------------------------------
+// Class: CCA E-Graph
+//-------------------------------------
+// Equivalence classes of the integer dataflow of a basic block, saturated with a small set of rewrites
+// (shl by a constant to mul, add of a negation to sub, and distributing / factoring mul over add and sub).
+// Values of other instructions and other blocks are leaves. Classes created by rewrites have no value of their own,
+// and the leader of a class is its earliest value. Rewriting stops when the rewrites have added nodelimit nodes,
+// or after iterlimit iterations.
+class CCAEGraph final {
+  private:
+	typedef std::array<unsigned, 5> NodeKey;
+	BasicBlock &BB_;
+	const CCAEGraphConstants &Constants_;
+	mutable std::vector<unsigned> parent_; // union-find over classes
+	std::vector<Value *> leader_;
+	std::vector<CCAENode> nodes_;
+	std::vector<unsigned> nodeclass_;
+	std::map<NodeKey, unsigned> hashcons_;
+	DenseMap<Value *, unsigned> classof_;
+	std::vector<std::vector<unsigned>> members_; // nodes of each class, valid after saturation
+	unsigned nodelimit_;
+	unsigned merges_;
+
+	unsigned newClass(Value *V);
+	unsigned addValue(Value *V);
+	unsigned addNode(CCAENode N, unsigned cls);
+	unsigned getNode(unsigned opcode, unsigned lhs, unsigned rhs);
+	unsigned getPowerOfTwo(unsigned exponent);
+	bool merge(unsigned a, unsigned b);
+	void rebuild(void);
+	std::vector<unsigned> collect(void);
+	void rewrite(unsigned n);
+	NodeKey key(const CCAENode &N) const;
+
+  public:
+	CCAEGraph(BasicBlock &BB, const CCAEGraphConstants &Constants, unsigned nodelimit, unsigned iterlimit);
+	unsigned find(unsigned cls) const;
+	unsigned classOf(Value *V) const;
+	Value *leader(unsigned cls) const { return leader_[find(cls)]; }
+	const CCAENode &node(unsigned n) const { return nodes_[n]; }
+	const std::vector<unsigned> &members(unsigned cls) const { return members_[find(cls)]; }
+	bool hasNode(Value *V, unsigned opcode) const;
+	void classify(const std::vector<unsigned> &opcodes, std::vector<std::vector<Instruction *>> &Roots) const;
+	unsigned size(void) const { return nodes_.size(); }
+	static const unsigned None = ~0u;
+};
+
+} // namespace cca
+} // namespace llvm
+
+#endif // PIMCCALLVMPASS_INSTRUMENTATION_CCA_EGRAPH_HPP_
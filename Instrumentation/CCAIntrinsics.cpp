@@ -0,0 +1,137 @@
+#include "Instrumentation/CCAIntrinsics.hpp"
+#include "Instrumentation/CCATarget.hpp"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/Instructions.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace llvm {
+namespace cca {
+
+//-------------------------------------
+// CCA Pseudo-Intrinsics
+//-------------------------------------
+static const char *const CCAMoveInName = "cca.move.in.";
+static const char *const CCAExecName = "cca.exec";
+static const char *const CCAMoveOutName = "cca.move.out.";
+
+// Declare a Pseudo-Intrinsic Accessing Only the CCA Registers
+static Function *getCCAFunction(Module &M, const std::string &name, FunctionType *FT, bool readonly) {
+	Function *F = M.getFunction(name);
+	if (F != nullptr) return F;
+	F = Function::Create(FT, GlobalValue::ExternalLinkage, name, M);
+	F->addFnAttr(Attribute::InaccessibleMemOnly);
+	F->addFnAttr(Attribute::NoUnwind);
+	F->addFnAttr(Attribute::WillReturn);
+	if (readonly) F->setOnlyReadsMemory();
+	return F;
+}
+
+Function *getCCAMoveIn(Module &M, unsigned inputs) {
+	Type *Int32Ty = Type::getInt32Ty(M.getContext());
+	FunctionType *FT = FunctionType::get(Type::getVoidTy(M.getContext()), std::vector<Type *>(2 * inputs, Int32Ty), false);
+	return getCCAFunction(M, CCAMoveInName + std::to_string(inputs), FT, false);
+}
+
+Function *getCCAExec(Module &M) {
+	FunctionType *FT = FunctionType::get(Type::getVoidTy(M.getContext()), {Type::getInt32Ty(M.getContext())}, false);
+	return getCCAFunction(M, CCAExecName, FT, false);
+}
+
+Function *getCCAMoveOut(Module &M, unsigned outputs) {
+	Type *Int32Ty = Type::getInt32Ty(M.getContext());
+	Type *RetTy = outputs == 1 ? Int32Ty : StructType::get(M.getContext(), std::vector<Type *>(outputs, Int32Ty));
+	FunctionType *FT = FunctionType::get(RetTy, std::vector<Type *>(outputs, Int32Ty), false);
+	return getCCAFunction(M, CCAMoveOutName + std::to_string(outputs), FT, true);
+}
+
+//-------------------------------------
+// Class: CCA Intrinsic Lowering Pass
+//-------------------------------------
+// Lower a Call to the Inline Assembly
+static void lowerCall(CallInst *CI, const std::string &asmstr, const std::string &constraints, std::vector<Value *> Args, bool tail) {
+	std::vector<Type *> ArgTys;
+	for (Value *V : Args) ArgTys.push_back(V->getType());
+	FunctionType *FT = FunctionType::get(CI->getType(), ArgTys, false);
+	InlineAsm *IA = InlineAsm::get(FT, asmstr, constraints, true);
+	CallInst *Lowered = CallInst::Create(FunctionCallee(FT, IA), Args, "", CI);
+	Lowered->setTailCall(tail);
+	Lowered->takeName(CI);
+	CI->replaceAllUsesWith(Lowered);
+	CI->eraseFromParent();
+}
+
+// Operand List of a CCA Move ("$0, $1, ...") and its Constraints ("r,r,..." or "=r,=r,...")
+static void getMoveOperands(unsigned length, const std::string &constraint, std::string &operands, std::string &constraints) {
+	for (unsigned i = 0; i < length; ++i) {
+		operands += (i == 0 ? "$" : ", $") + std::to_string(i);
+		constraints += (i == 0 ? "" : ",") + constraint;
+	}
+}
+
+// Constant Register Operands of a Call (the first n operands)
+static bool getRegisters(CallInst *CI, unsigned n, std::vector<unsigned> &Regs) {
+	for (unsigned i = 0; i < n; ++i) {
+		if (!isa<ConstantInt>(CI->getArgOperand(i))) return false;
+		Regs.push_back(cast<ConstantInt>(CI->getArgOperand(i))->getZExtValue());
+	}
+	return true;
+}
+
+PreservedAnalyses CCALowerIntrinsicsPass::run(Module &M, ModuleAnalysisManager &MAM) {
+	std::vector<Function *> Intrinsics;
+	for (Function &F : M) {
+		if (!F.isDeclaration()) continue;
+		if (F.getName().startswith(CCAMoveInName) || F.getName() == CCAExecName || F.getName().startswith(CCAMoveOutName)) Intrinsics.push_back(&F);
+	}
+	if (Intrinsics.empty()) return PreservedAnalyses::all();
+	const CCATarget &Target = CCATarget::get();
+
+	for (Function *F : Intrinsics) {
+		StringRef name = F->getName();
+		std::vector<CallInst *> Calls;
+		for (User *U : F->users())
+			if (isa<CallInst>(U) && cast<CallInst>(U)->getCalledFunction() == F) Calls.push_back(cast<CallInst>(U));
+		for (CallInst *CI : Calls) {
+			std::string operands, constraints;
+			std::vector<unsigned> Regs;
+			// Registers from the first one of the cca register file are moved at once, and the others one by one
+			if (name.startswith(CCAMoveInName) && getRegisters(CI, CI->arg_size() / 2, Regs)) {
+				std::vector<Value *> Values(CI->arg_begin() + Regs.size(), CI->arg_end());
+				if (Target.isBlock(Regs)) {
+					getMoveOperands(Regs.size(), "r", operands, constraints);
+					lowerCall(CI, "#removethiscomment cca_move " + operands, constraints, Values, true);
+				} else {
+					for (unsigned i = 0; i < Regs.size(); ++i) {
+						operands += (i == 0 ? "" : "\n\t") + std::string("#removethiscomment move r") + std::to_string(Regs[i]) + ", $" + std::to_string(i);
+						constraints += (i == 0 ? "r" : ",r");
+					}
+					lowerCall(CI, operands, constraints, Values, true);
+				}
+			} else if (name == CCAExecName && isa<ConstantInt>(CI->getArgOperand(0))) {
+				uint64_t rule = cast<ConstantInt>(CI->getArgOperand(0))->getZExtValue();
+				lowerCall(CI, "#removethiscomment cca " + std::to_string(rule), "", {}, true);
+			} else if (name.startswith(CCAMoveOutName) && getRegisters(CI, CI->arg_size(), Regs)) {
+				if (Regs.size() == 1) lowerCall(CI, "#removethiscomment move $0, r" + std::to_string(Regs[0]), "=r", {}, false);
+				else if (Target.isBlock(Regs)) {
+					getMoveOperands(Regs.size(), "=r", operands, constraints);
+					lowerCall(CI, "#removethiscomment cca_move " + operands, constraints, {}, false);
+				} else {
+					for (unsigned i = 0; i < Regs.size(); ++i) {
+						operands += (i == 0 ? "" : "\n\t") + std::string("#removethiscomment move $") + std::to_string(i) + ", r" + std::to_string(Regs[i]);
+						constraints += (i == 0 ? "=r" : ",=r");
+					}
+					lowerCall(CI, operands, constraints, {}, false);
+				}
+			} else
+				std::cerr << "[PIM-CCA-PASS][ERROR] cannot lower the call to " << name.str() << "\n";
+		}
+		if (F->use_empty()) F->eraseFromParent();
+	}
+	return PreservedAnalyses::none();
+}
+
+} // namespace cca
+} // namespace llvm
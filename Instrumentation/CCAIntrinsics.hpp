@@ -0,0 +1,37 @@
+#ifndef PIMCCALLVMPASS_INSTRUMENTATION_CCA_INTRINSICS_HPP_
+#define PIMCCALLVMPASS_INSTRUMENTATION_CCA_INTRINSICS_HPP_
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+namespace cca {
+
+//-------------------------------------
+// CCA Pseudo-Intrinsics
+//-------------------------------------
+// A cca site is a sequence of calls to the declarations
+//   void cca.move.in.<n>(i32 reg, ..., i32 value, ...)  move n inputs to the registers
+//   void cca.exec(i32 rule)                             run the cca of the rule
+//   T    cca.move.out.<n>(i32 reg, ...)                 move n outputs from the registers (T is i32, or a struct of n i32)
+// which only access memory inaccessible to the module (the cca registers, read only by cca.move.out),
+// so the optimizer may move, hoist and merge other code around them. They are lowered to inline assembly at the end.
+// The rule and the registers are constants (immarg is reserved for the intrinsics of LLVM itself).
+Function *getCCAMoveIn(Module &M, unsigned inputs);
+Function *getCCAExec(Module &M);
+Function *getCCAMoveOut(Module &M, unsigned outputs);
+
+//-------------------------------------
+// Class: CCA Intrinsic Lowering Pass
+//-------------------------------------
+// Lowers the pseudo-intrinsics to the commented inline assembly of the DPU, and removes their declarations
+struct CCALowerIntrinsicsPass : public PassInfoMixin<CCALowerIntrinsicsPass> {
+	PreservedAnalyses run(Module &, ModuleAnalysisManager &);
+	static bool isRequired(void) { return true; }
+};
+
+} // namespace cca
+} // namespace llvm
+
+#endif // PIMCCALLVMPASS_INSTRUMENTATION_CCA_INTRINSICS_HPP_
@@ -5,7 +5,6 @@
 #include "llvm/IR/Instructions.h"
 #include <algorithm>
 #include <iostream>
-#include <numeric>
 #include <stack>
 #include <string>
 #include <vector>
@@ -209,29 +208,8 @@ void CCAPatternGraphSelectNode::print(unsigned indent, llvm::raw_ostream &os) co
 	false_expr_->print(indent + 4, os);
 }
 
-// Ready For Search
-void CCAPatternGraphRegisterNode::readyForSearch(void) {
-	if (SG_ != nullptr) SG_->readyForSearch();
-}
-
-void CCAPatternGraphOperatorNode::readyForSearch(void) {
-	left_->readyForSearch();
-	right_->readyForSearch();
-}
-
-void CCAPatternGraphCompareNode::readyForSearch(void) {
-	left_->readyForSearch();
-	right_->readyForSearch();
-}
-
-void CCAPatternGraphSelectNode::readyForSearch(void) {
-	cmp_->readyForSearch();
-	true_expr_->readyForSearch();
-	false_expr_->readyForSearch();
-}
-
 // Check Valid
-bool CCAPatternGraphRegisterNode::checkValid(void) {
+bool CCAPatternGraphRegisterNode::checkValid(CCAVisitSet &Visited) const {
 	if ((regtype_ == 'o' || regtype_ == 't') && SG_ == nullptr) {
 		std::cerr << "[PIM-CCA-PASS][ERROR] The register \"" << regtype_ << regnum_ << "\" is not linked\n";
 		return false;
@@ -239,28 +217,28 @@ bool CCAPatternGraphRegisterNode::checkValid(void) {
 	return true;
 }
 
-bool CCAPatternGraphOperatorNode::checkValid(void) {
-	if (!left_->checkValid()) return false;
-	if (!right_->checkValid()) return false;
+bool CCAPatternGraphOperatorNode::checkValid(CCAVisitSet &Visited) const {
+	if (!left_->checkValid(Visited)) return false;
+	if (!right_->checkValid(Visited)) return false;
 	return true;
 }
 
-bool CCAPatternGraphCompareNode::checkValid(void) {
-	if (!left_->checkValid()) return false;
-	if (!right_->checkValid()) return false;
+bool CCAPatternGraphCompareNode::checkValid(CCAVisitSet &Visited) const {
+	if (!left_->checkValid(Visited)) return false;
+	if (!right_->checkValid(Visited)) return false;
 	return true;
 }
 
-bool CCAPatternGraphSelectNode::checkValid(void) {
-	if (!cmp_->checkValid()) return false;
-	if (!true_expr_->checkValid()) return false;
-	if (!false_expr_->checkValid()) return false;
+bool CCAPatternGraphSelectNode::checkValid(CCAVisitSet &Visited) const {
+	if (!cmp_->checkValid(Visited)) return false;
+	if (!true_expr_->checkValid(Visited)) return false;
+	if (!false_expr_->checkValid(Visited)) return false;
 	return true;
 }
 
 // Link Subgraph
-bool CCAPatternGraphRegisterNode::linkSubgraph(char regtype, unsigned int regnum, CCAPatternSubGraph *SG) {
-	if (SG_ != nullptr) return SG_->linkSubgraph(regtype, regnum, SG);
+bool CCAPatternGraphRegisterNode::linkSubgraph(char regtype, unsigned regnum, CCAPatternSubGraph *SG, CCAVisitSet &Visited) {
+	if (SG_ != nullptr) return SG_->linkSubgraph(regtype, regnum, SG, Visited);
 	if (SG_ == nullptr && regtype_ == regtype && regnum_ == regnum) {
 		SG_ = SG;
 		return true;
@@ -268,190 +246,188 @@ bool CCAPatternGraphRegisterNode::linkSubgraph(char regtype, unsigned int regnum
 	return false;
 }
 
-bool CCAPatternGraphOperatorNode::linkSubgraph(char regtype, unsigned int regnum, CCAPatternSubGraph *SG) {
+bool CCAPatternGraphOperatorNode::linkSubgraph(char regtype, unsigned regnum, CCAPatternSubGraph *SG, CCAVisitSet &Visited) {
 	bool set = false;
-	if (left_->linkSubgraph(regtype, regnum, SG)) set = true;
-	if (right_->linkSubgraph(regtype, regnum, SG)) set = true;
+	if (left_->linkSubgraph(regtype, regnum, SG, Visited)) set = true;
+	if (right_->linkSubgraph(regtype, regnum, SG, Visited)) set = true;
 	return set;
 }
 
-bool CCAPatternGraphCompareNode::linkSubgraph(char regtype, unsigned int regnum, CCAPatternSubGraph *SG) {
+bool CCAPatternGraphCompareNode::linkSubgraph(char regtype, unsigned regnum, CCAPatternSubGraph *SG, CCAVisitSet &Visited) {
 	bool set = false;
-	if (left_->linkSubgraph(regtype, regnum, SG)) set = true;
-	if (right_->linkSubgraph(regtype, regnum, SG)) set = true;
+	if (left_->linkSubgraph(regtype, regnum, SG, Visited)) set = true;
+	if (right_->linkSubgraph(regtype, regnum, SG, Visited)) set = true;
 	return set;
 }
 
-bool CCAPatternGraphSelectNode::linkSubgraph(char regtype, unsigned int regnum, CCAPatternSubGraph *SG) {
+bool CCAPatternGraphSelectNode::linkSubgraph(char regtype, unsigned regnum, CCAPatternSubGraph *SG, CCAVisitSet &Visited) {
 	bool set = false;
-	if (cmp_->linkSubgraph(regtype, regnum, SG)) set = true;
-	if (true_expr_->linkSubgraph(regtype, regnum, SG)) set = true;
-	if (false_expr_->linkSubgraph(regtype, regnum, SG)) set = true;
+	if (cmp_->linkSubgraph(regtype, regnum, SG, Visited)) set = true;
+	if (true_expr_->linkSubgraph(regtype, regnum, SG, Visited)) set = true;
+	if (false_expr_->linkSubgraph(regtype, regnum, SG, Visited)) set = true;
 	return set;
 }
 
-// Get Flag Sizes
-unsigned CCAPatternGraphRegisterNode::flagsize(void) {
-	if (SG_ != nullptr) return SG_->flagsize();
-	return 0;
-}
-unsigned CCAPatternGraphOperatorNode::flagsize(void) { return left_->flagsize() + right_->flagsize() + (reversable() ? 1 : 0); }
-unsigned CCAPatternGraphCompareNode::flagsize(void) { return left_->flagsize() + right_->flagsize() + (reversable() ? 1 : 0); }
-unsigned CCAPatternGraphSelectNode::flagsize(void) { return cmp_->flagsize() + true_expr_->flagsize() + false_expr_->flagsize(); }
-
-// Set Reverse From Flag Vector
-void CCAPatternGraphRegisterNode::setReverse(const std::vector<bool> &flags, unsigned int &index) {
-	if (SG_ != nullptr) SG_->setReverse(flags, index);
+// Compile to Matcher Program
+// Each node checks the value in its slot and loads its operands into new slots; commutative nodes leave a choice point
+// so the swapped operand order is retried only when the rest of the search fails.
+void CCAPatternGraphRegisterNode::compile(CCAPatternProgram &P, unsigned slot, int userslot) const {
+	if (regtype_ != 'i' && regtype_ != 'o' && regtype_ != 't') {
+		P.emit(CCAMatchOp::Fail);
+		return;
+	}
+	P.emit(CCAMatchOp::CheckRegister, slot);
+	// Temporary registers are removed, so all their users should be in the pattern
+	if (regtype_ == 't' && userslot >= 0) P.emit(CCAMatchOp::RecordRemove, slot, userslot);
+	unsigned reg = P.regIndex(regtype_, regnum_);
+	// For Input Registers, and Registers already Bound by an Enclosing Subgraph
+	if (regtype_ == 'i' || P.isOpen(reg)) {
+		P.emit(CCAMatchOp::BindRegister, slot, reg);
+		return;
+	}
+	// For Output & Temporary Registers, Match the Linked Subgraph only at the First Binding
+	unsigned at = P.emit(CCAMatchOp::BindLinked, slot, reg);
+	if (SG_ != nullptr) {
+		P.open(reg, true);
+		SG_->compile(P, slot, -1);
+		P.open(reg, false);
+	} else
+		P.emit(CCAMatchOp::Fail);
+	P.patch(at, P.size());
 }
 
-void CCAPatternGraphOperatorNode::setReverse(const std::vector<bool> &flags, unsigned &index) {
-	if (reversable()) {
-		reversed_ = flags[index];
-		index++;
+// Flatten a Chain of the Same Associative & Commutative Operator into its Leaves (Left to Right)
+void CCAPatternGraphOperatorNode::getACLeaves(std::vector<CCAPatternGraphNode *> &Leaves) const {
+	for (CCAPatternGraphNode *OP : {left_, right_}) {
+		// Only operator nodes have the opcode of an operator
+		if (reversable() && OP->opcode() == opcode()) static_cast<const CCAPatternGraphOperatorNode *>(OP)->getACLeaves(Leaves);
+		else
+			Leaves.push_back(OP);
 	}
-	left_->setReverse(flags, index);
-	right_->setReverse(flags, index);
 }
 
-void CCAPatternGraphCompareNode::setReverse(const std::vector<bool> &flags, unsigned &index) {
-	if (reversable()) {
-		reversed_ = flags[index];
-		index++;
+void CCAPatternGraphOperatorNode::compile(CCAPatternProgram &P, unsigned slot, int userslot) const {
+	P.emit(CCAMatchOp::CheckBinOp, slot, 0, 0, opcode());
+	if (userslot >= 0) P.emit(CCAMatchOp::RecordRemove, slot, userslot);
+	// Chains are matched as multisets of leaves, whatever the tree shape of the chain in the code
+	std::vector<CCAPatternGraphNode *> Leaves;
+	getACLeaves(Leaves);
+	if (Leaves.size() > 2 && !P.egraph()) {
+		unsigned base = P.newSlot();
+		for (unsigned idx = 1; idx < 2 * Leaves.size(); ++idx) P.newSlot();
+		P.emit(CCAMatchOp::MatchAC, slot, Leaves.size(), base, opcode(), P.newACScratch());
+		for (unsigned idx = 0; idx < Leaves.size(); ++idx) Leaves[idx]->compile(P, base + idx, base + Leaves.size() + idx);
+		return;
 	}
-	left_->setReverse(flags, index);
-	right_->setReverse(flags, index);
-}
-
-void CCAPatternGraphSelectNode::setReverse(const std::vector<bool> &flags, unsigned &index) {
-	cmp_->setReverse(flags, index);
-	true_expr_->setReverse(flags, index);
-	false_expr_->setReverse(flags, index);
-}
-
-// Match with Codes
-bool CCAPatternGraphRegisterNode::matchWithCode(Value *StartPoint,
-												const std::set<Instruction *> &AlreadyRemoved,
-												std::map<unsigned int, Value *> &IRVM,
-												std::map<unsigned int, Value *> &ORVM,
-												std::map<unsigned int, Value *> &TRVM) const {
-	// Check Type
-	if (StartPoint->getType() != Type::getInt32Ty(StartPoint->getContext())) return false;
-	// Already Removed or Matched
-	if (isa<Constant>(StartPoint)) return false;
-	if (isa<Instruction>(StartPoint) && AlreadyRemoved.find(cast<Instruction>(StartPoint)) != AlreadyRemoved.end()) return false;
-	// For Input Registers
-	if (regtype_ == 'i') {
-		if (IRVM.find(regnum_) != IRVM.end()) return IRVM.at(regnum_) == StartPoint;
-		IRVM.insert({regnum_, StartPoint}); // Insert
-		return true;
-	}
-	// For Output Register
-	else if (regtype_ == 'o') {
-		if (ORVM.find(regnum_) != ORVM.end()) return ORVM.at(regnum_) == StartPoint;
-		if (SG_ != nullptr) {
-			if (SG_->matchWithCode(StartPoint, AlreadyRemoved, IRVM, ORVM, TRVM)) {
-				ORVM.insert({regnum_, StartPoint}); // Insert
-				return true;
-			}
-		}
-		return false;
-	}
-	// For Temporary Registers
-	else if (regtype_ == 't') {
-		if (TRVM.find(regnum_) != TRVM.end()) return TRVM.at(regnum_) == StartPoint;
-		if (SG_ != nullptr) {
-			if (SG_->matchWithCode(StartPoint, AlreadyRemoved, IRVM, ORVM, TRVM)) {
-				TRVM.insert({regnum_, StartPoint}); // Insert
-				return true;
-			}
-		}
-		return false;
-	}
-	// Error
+	unsigned l = P.newSlot(), r = P.newSlot();
+	P.emit(CCAMatchOp::LoadOperand, l, slot, 0);
+	P.emit(CCAMatchOp::LoadOperand, r, slot, 1);
+	if (reversable()) P.emit(CCAMatchOp::TrySwap, l, r);
+	left_->compile(P, l, slot);
+	right_->compile(P, r, slot);
+}
+
+void CCAPatternGraphCompareNode::compile(CCAPatternProgram &P, unsigned slot, int userslot) const {
+	P.emit(CCAMatchOp::CheckICmp, slot, 0, swappedPredicate(), predicate());
+	if (userslot >= 0) P.emit(CCAMatchOp::RecordRemove, slot, userslot);
+	unsigned l = P.newSlot(), r = P.newSlot();
+	P.emit(CCAMatchOp::LoadOperand, l, slot, 0);
+	P.emit(CCAMatchOp::LoadOperand, r, slot, 1);
+	if (reversable()) P.emit(CCAMatchOp::TrySwap, l, r);
+	else if (swappedPredicate() != predicate())
+		P.emit(CCAMatchOp::SwapIfPred, l, r, slot, swappedPredicate());
+	left_->compile(P, l, slot);
+	right_->compile(P, r, slot);
+}
+
+void CCAPatternGraphSelectNode::compile(CCAPatternProgram &P, unsigned slot, int userslot) const {
+	P.emit(CCAMatchOp::CheckSelect, slot);
+	if (userslot >= 0) P.emit(CCAMatchOp::RecordRemove, slot, userslot);
+	unsigned c = P.newSlot(), t = P.newSlot(), f = P.newSlot();
+	P.emit(CCAMatchOp::LoadOperand, c, slot, 0);
+	P.emit(CCAMatchOp::LoadOperand, t, slot, 1);
+	P.emit(CCAMatchOp::LoadOperand, f, slot, 2);
+	cmp_->compile(P, c, slot);
+	true_expr_->compile(P, t, slot);
+	false_expr_->compile(P, f, slot);
+}
+
+// Get Register Depth (Operand Levels below the Root)
+void CCAPatternGraphRegisterNode::getRegisterDepth(unsigned depth, CCARegisterDepths &RDM, CCAVisitSet &Visited) const {
+	RDM[{regtype_, regnum_}].insert(depth);
+	if (SG_ != nullptr) SG_->getRegisterDepth(depth, RDM, Visited);
+}
+
+// A leaf of a chain with n leaves can be 1 to n-1 levels below the chain
+void CCAPatternGraphOperatorNode::getRegisterDepth(unsigned depth, CCARegisterDepths &RDM, CCAVisitSet &Visited) const {
+	std::vector<CCAPatternGraphNode *> Leaves;
+	getACLeaves(Leaves);
+	for (auto *Leaf : Leaves)
+		for (unsigned level = 1; level < Leaves.size(); ++level) Leaf->getRegisterDepth(depth + level, RDM, Visited);
+}
+
+void CCAPatternGraphCompareNode::getRegisterDepth(unsigned depth, CCARegisterDepths &RDM, CCAVisitSet &Visited) const {
+	left_->getRegisterDepth(depth + 1, RDM, Visited);
+	right_->getRegisterDepth(depth + 1, RDM, Visited);
+}
+
+void CCAPatternGraphSelectNode::getRegisterDepth(unsigned depth, CCARegisterDepths &RDM, CCAVisitSet &Visited) const {
+	cmp_->getRegisterDepth(depth + 1, RDM, Visited);
+	true_expr_->getRegisterDepth(depth + 1, RDM, Visited);
+	false_expr_->getRegisterDepth(depth + 1, RDM, Visited);
+}
+
+// Get Shapes (Preorder Opcode Sequences down to the Shape Depth, One per Operand Order of Commutative Nodes)
+static const unsigned CCAShapeDepth = 3;
+
+void CCAPatternGraphRegisterNode::getShapes(unsigned depth, std::vector<CCAShape> &Shapes) const {
+	// Values of linked registers have the shape of their subgraphs
+	if (regtype_ != 'i' && SG_ != nullptr && depth < CCAShapeDepth) SG_->getShapes(depth, Shapes);
 	else
-		return false;
+		for (auto &Shape : Shapes) Shape.push_back(CCAShapeAny);
 }
 
-bool CCAPatternGraphOperatorNode::matchWithCode(Value *StartPoint,
-												const std::set<Instruction *> &AlreadyRemoved,
-												std::map<unsigned int, Value *> &IRVM,
-												std::map<unsigned int, Value *> &ORVM,
-												std::map<unsigned int, Value *> &TRVM) const {
-	unsigned binaryOps = opcode();
-	if (!llvm::isa<BinaryOperator>(StartPoint) || cast<BinaryOperator>(StartPoint)->getOpcode() != binaryOps) return false;
-	// Check Matched of Child Nodes
-	BinaryOperator *BO = cast<BinaryOperator>(StartPoint);
-	return left_->matchWithCode(BO->getOperand(reversed_ ? 1 : 0), AlreadyRemoved, IRVM, ORVM, TRVM) &&
-		   right_->matchWithCode(BO->getOperand(reversed_ ? 0 : 1), AlreadyRemoved, IRVM, ORVM, TRVM);
-}
-
-bool CCAPatternGraphCompareNode::matchWithCode(Value *StartPoint,
-											   const std::set<Instruction *> &AlreadyRemoved,
-											   std::map<unsigned int, Value *> &IRVM,
-											   std::map<unsigned int, Value *> &ORVM,
-											   std::map<unsigned int, Value *> &TRVM) const {
-	if (!llvm::isa<ICmpInst>(StartPoint) || cast<ICmpInst>(StartPoint)->getPredicate() != predicate()) return false;
-	// Check Matched of Child Nodes
-	ICmpInst *CI = cast<ICmpInst>(StartPoint);
-	return left_->matchWithCode(CI->getOperand(reversed_ ? 1 : 0), AlreadyRemoved, IRVM, ORVM, TRVM) &&
-		   right_->matchWithCode(CI->getOperand(reversed_ ? 0 : 1), AlreadyRemoved, IRVM, ORVM, TRVM);
-}
-
-bool CCAPatternGraphSelectNode::matchWithCode(Value *StartPoint,
-											  const std::set<Instruction *> &AlreadyRemoved,
-											  std::map<unsigned int, Value *> &IRVM,
-											  std::map<unsigned int, Value *> &ORVM,
-											  std::map<unsigned int, Value *> &TRVM) const {
-	if (!llvm::isa<SelectInst>(StartPoint)) return false;
-	// Check Matched of Child Nodes
-	SelectInst *SI = cast<SelectInst>(StartPoint);
-	return cmp_->matchWithCode(SI->getCondition(), AlreadyRemoved, IRVM, ORVM, TRVM) &&
-		   true_expr_->matchWithCode(SI->getTrueValue(), AlreadyRemoved, IRVM, ORVM, TRVM) &&
-		   false_expr_->matchWithCode(SI->getFalseValue(), AlreadyRemoved, IRVM, ORVM, TRVM);
-}
-
-// Get Remove List
-void CCAPatternGraphRegisterNode::getRemoveList(Value *StartPoint, User *UserTarget, std::map<Value *, std::set<User *>> &RemoveList) {
-	if (SG_ != nullptr) SG_->getRemoveList(StartPoint, UserTarget, RemoveList);
-	if (regtype_ == 't' && UserTarget != nullptr) {
-		if (RemoveList.find(StartPoint) != RemoveList.end()) RemoveList.at(StartPoint).insert(UserTarget);
-		else
-			RemoveList.insert({StartPoint, {UserTarget}});
+static void getOperandShapes(unsigned depth,
+							 CCAShapeKey key,
+							 bool reversable,
+							 const std::vector<const CCAPatternGraphNode *> &Operands,
+							 std::vector<CCAShape> &Shapes) {
+	if (depth >= CCAShapeDepth) {
+		for (auto &Shape : Shapes) Shape.push_back(CCAShapeAny);
+		return;
 	}
-}
-
-void CCAPatternGraphOperatorNode::getRemoveList(Value *StartPoint, User *UserTarget, std::map<Value *, std::set<User *>> &RemoveList) {
-	if (UserTarget != nullptr) {
-		if (RemoveList.find(StartPoint) != RemoveList.end()) RemoveList.at(StartPoint).insert(UserTarget);
-		else
-			RemoveList.insert({StartPoint, {UserTarget}});
+	for (auto &Shape : Shapes) Shape.push_back(key);
+	std::vector<CCAShape> Swapped = Shapes;
+	for (auto *OP : Operands) OP->getShapes(depth + 1, Shapes);
+	if (!reversable) return;
+	for (auto OPIter = Operands.rbegin(); OPIter != Operands.rend(); ++OPIter) (*OPIter)->getShapes(depth + 1, Swapped);
+	Shapes.insert(Shapes.end(), Swapped.begin(), Swapped.end());
+}
+
+void CCAPatternGraphOperatorNode::getShapes(unsigned depth, std::vector<CCAShape> &Shapes) const {
+	std::vector<CCAPatternGraphNode *> Leaves;
+	getACLeaves(Leaves);
+	// The operands of a chain can be any part of it
+	if (Leaves.size() > 2 && depth < CCAShapeDepth) {
+		for (auto &Shape : Shapes) Shape.insert(Shape.end(), {makeShapeKey(opcode()), CCAShapeAny, CCAShapeAny});
+		return;
 	}
-	User *U = cast<User>(StartPoint);
-	left_->getRemoveList(U->getOperand(reversed_ ? 1 : 0), U, RemoveList);
-	right_->getRemoveList(U->getOperand(reversed_ ? 0 : 1), U, RemoveList);
+	getOperandShapes(depth, makeShapeKey(opcode()), reversable(), {left_, right_}, Shapes);
 }
 
-void CCAPatternGraphCompareNode::getRemoveList(Value *StartPoint, User *UserTarget, std::map<Value *, std::set<User *>> &RemoveList) {
-	if (UserTarget != nullptr) {
-		if (RemoveList.find(StartPoint) != RemoveList.end()) RemoveList.at(StartPoint).insert(UserTarget);
-		else
-			RemoveList.insert({StartPoint, {UserTarget}});
+void CCAPatternGraphCompareNode::getShapes(unsigned depth, std::vector<CCAShape> &Shapes) const {
+	if (reversable() || swappedPredicate() == predicate()) {
+		getOperandShapes(depth, makeShapeKey(opcode(), predicate()), reversable(), {left_, right_}, Shapes);
+		return;
 	}
-	User *U = cast<User>(StartPoint);
-	left_->getRemoveList(U->getOperand(reversed_ ? 1 : 0), U, RemoveList);
-	right_->getRemoveList(U->getOperand(reversed_ ? 0 : 1), U, RemoveList);
+	std::vector<CCAShape> Swapped = Shapes;
+	getOperandShapes(depth, makeShapeKey(opcode(), predicate()), false, {left_, right_}, Shapes);
+	getOperandShapes(depth, makeShapeKey(opcode(), swappedPredicate()), false, {right_, left_}, Swapped);
+	Shapes.insert(Shapes.end(), Swapped.begin(), Swapped.end());
 }
 
-void CCAPatternGraphSelectNode::getRemoveList(Value *StartPoint, User *UserTarget, std::map<Value *, std::set<User *>> &RemoveList) {
-	if (UserTarget != nullptr) {
-		if (RemoveList.find(StartPoint) != RemoveList.end()) RemoveList.at(StartPoint).insert(UserTarget);
-		else
-			RemoveList.insert({StartPoint, {UserTarget}});
-	}
-	SelectInst *SI = cast<SelectInst>(StartPoint);
-	cmp_->getRemoveList(SI->getCondition(), SI, RemoveList);
-	true_expr_->getRemoveList(SI->getTrueValue(), SI, RemoveList);
-	false_expr_->getRemoveList(SI->getFalseValue(), SI, RemoveList);
+void CCAPatternGraphSelectNode::getShapes(unsigned depth, std::vector<CCAShape> &Shapes) const {
+	getOperandShapes(depth, makeShapeKey(opcode()), false, {cmp_, true_expr_, false_expr_}, Shapes);
 }
 
 //-------------------------------------------
@@ -459,13 +435,13 @@ void CCAPatternGraphSelectNode::getRemoveList(Value *StartPoint, User *UserTarge
 //-------------------------------------------
 // Constructor
 CCAPatternGraph::CCAPatternGraph(unsigned rule_number, const std::vector<CCAPatternSubGraph *> SubGraphs)
-	: rule_number_(rule_number), graphs_(SubGraphs), linked_graphs_(SubGraphs) {
+	: rule_number_(rule_number), graphs_(SubGraphs), linked_graphs_(SubGraphs), root_links_(), program_(), eprogram_(true) {
 	for (auto iter = linked_graphs_.begin(); iter != linked_graphs_.end();) {
 		CCAPatternSubGraph *&SG = *iter;
 		bool merged = false;
 		for (auto it = linked_graphs_.begin(); it != linked_graphs_.end(); ++it) {
-			(*it)->readyForSearch();
-			merged = merged || (*it)->linkSubgraph(SG->regtype(), SG->regnum(), SG);
+			CCAVisitSet Visited;
+			merged = merged || (*it)->linkSubgraph(SG->regtype(), SG->regnum(), SG, Visited);
 		}
 		if (merged) iter = linked_graphs_.erase(iter);
 		else
@@ -478,9 +454,53 @@ CCAPatternGraph::CCAPatternGraph(unsigned rule_number, const std::vector<CCAPatt
 	}
 	for (auto iter = linked_graphs_.begin(); iter != linked_graphs_.end(); ++iter) {
 		CCAPatternSubGraph *&SG = *iter;
-		SG->readyForSearch();
-		SG->checkValid();
+		CCAVisitSet Visited;
+		SG->checkValid(Visited);
+	}
+	// Link Each Root to the Nearest Earlier Root Sharing a Register
+	std::vector<CCARegisterDepths> RDMVec(linked_graphs_.size());
+	for (unsigned gidx = 0; gidx < linked_graphs_.size(); ++gidx) {
+		CCAVisitSet Visited;
+		linked_graphs_[gidx]->getRegisterDepth(0, RDMVec[gidx], Visited);
+	}
+	root_links_.resize(linked_graphs_.size());
+	for (unsigned gidx = 1; gidx < linked_graphs_.size(); ++gidx) {
+		CCAPatternRootLink &L = root_links_[gidx];
+		unsigned bestcost = 0;
+		for (unsigned aidx = 0; aidx < gidx; ++aidx) {
+			for (const auto &mapIter : RDMVec[gidx]) {
+				auto AnchorIter = RDMVec[aidx].find(mapIter.first);
+				if (AnchorIter == RDMVec[aidx].end()) continue;
+				unsigned cost = *AnchorIter->second.rbegin() + *mapIter.second.rbegin();
+				if (L.linked && cost >= bestcost) continue;
+				L.linked = true;
+				L.anchor = aidx;
+				L.down = AnchorIter->second;
+				L.up = mapIter.second;
+				bestcost = cost;
+			}
+		}
 	}
+	compile(program_);
+	compile(eprogram_);
+	for (const CCAPatternProgram *P : {&program_, &eprogram_})
+		if (!P->compiled()) {
+			std::cerr << "[PIM-CCA-PASS][ERROR] The rule " << rule_number << " is too large to compile (" << P->error() << ")\n";
+			break;
+		}
+}
+
+// Compile the Output Roots in Order, and Accept when All of them are Matched
+// (all roots are bound first, so a root register used inside an earlier root must be that root)
+void CCAPatternGraph::compile(CCAPatternProgram &P) const {
+	std::vector<unsigned> RootSlots;
+	for (auto &SG : linked_graphs_) {
+		RootSlots.push_back(P.newSlot());
+		P.emit(CCAMatchOp::LoadRoot, RootSlots.back(), 0, 0, RootSlots.size() - 1);
+		P.emit(CCAMatchOp::BindRegister, RootSlots.back(), P.regIndex(SG->regtype(), SG->regnum()));
+	}
+	for (unsigned gidx = 0; gidx < linked_graphs_.size(); ++gidx) linked_graphs_[gidx]->compile(P, RootSlots[gidx], -1);
+	P.emit(linked_graphs_.empty() ? CCAMatchOp::Fail : CCAMatchOp::Accept);
 }
 
 // Print
@@ -494,106 +514,32 @@ void CCAPatternGraph::print(unsigned int indent, llvm::raw_ostream &os) const {
 	for (auto &SG : linked_graphs_) SG->print(indent, os);
 }
 
+// Root Shapes
+std::vector<CCAShape> CCAPatternGraph::root_shapes(unsigned gidx) const {
+	std::vector<CCAShape> Shapes(1);
+	linked_graphs_.at(gidx)->getShapes(0, Shapes);
+	std::sort(Shapes.begin(), Shapes.end());
+	Shapes.erase(std::unique(Shapes.begin(), Shapes.end()), Shapes.end());
+	return Shapes;
+}
+
 // Match With Codes
 bool CCAPatternGraph::matchWithCode(const std::vector<Instruction *> &Candidate,
 									const std::set<Instruction *> &UnRemovable,
 									std::set<Instruction *> &Removed,
-									std::map<unsigned, Value *> &InputRegValueMap,
-									std::map<unsigned, Value *> &OutputRegValueMap) const {
-	std::vector<unsigned> flagsize;
-	for (auto &G : linked_graphs_) {
-		G->readyForSearch();
-		flagsize.push_back(G->flagsize());
-	}
-	unsigned flagend = std::accumulate(flagsize.begin(), flagsize.end(), 0);
-
+									CCAMatchState &S,
+									bool next) const {
+	if (Candidate.empty()) return false;
 	for (Instruction *I : Candidate)
 		if (UnRemovable.find(I) != UnRemovable.end()) return false;
 
-	for (unsigned flag = 0; flag < (0x1 << flagend); ++flag) {
-		std::map<unsigned, Value *> IRVM, ORVM(OutputRegValueMap), TRVM;
-		std::map<Value *, std::set<User *>> RL;
-
-		unsigned matched = true;
-		for (unsigned gidx = 0; gidx < linked_graphs_.size(); ++gidx) {
-			CCAPatternSubGraph *G = linked_graphs_[gidx];
-			Instruction *StartPoint = Candidate[gidx];
-			// Set Reversed
-			std::vector<bool> reversed(flagsize[gidx], false);
-			unsigned partialflag = (flag >> std::accumulate(flagsize.begin(), flagsize.begin() + gidx, 0));
-			for (unsigned fidx = 0; fidx < flagsize[gidx]; ++fidx) reversed[fidx] = (partialflag & (0x1 << fidx)) ? true : false;
-			unsigned index = 0;
-			G->readyForSearch();
-			G->setReverse(reversed, index);
-			// Match with Code
-			if (!G->matchWithCode(StartPoint, Removed, IRVM, ORVM, TRVM)) {
-				matched = false;
-				break;
-			}
-			// Get Remove List
-			G->readyForSearch();
-			G->getRemoveList(StartPoint, nullptr, RL);
-		}
-		if (!matched) continue;
-		// Check Remove Lists
-		std::set<Instruction *> RIL;
-		BasicBlock *parent = nullptr;
-		for (auto &mapIter : RL) {
-			// if(!isa<Instruction>(mapIter.first)) /* error */
-			Instruction *I = cast<Instruction>(mapIter.first);
-			// Check Instructions are Removable
-			if (UnRemovable.find(I) != UnRemovable.end()) {
-				matched = false;
-				break;
-			}
-			// Check Instructions came from same Parent
-			if (parent == nullptr) parent = I->getParent();
-			else if (parent != I->getParent()) {
-				matched = false;
-				break;
-			}
-			// Check Users of Instructions to be Removed
-			for (auto UserIter : I->users()) {
-				if (mapIter.second.find(UserIter) != mapIter.second.end()) continue;
-				if (isa<StoreInst>(UserIter)) {
-					// Check Other Store Exists after This
-					StoreInst *S = cast<StoreInst>(UserIter);
-					bool removableStore = false;
-					for (auto SPIter = S->getIterator(); SPIter != parent->end(); ++SPIter) {
-						if (!isa<StoreInst>(SPIter)) continue;
-						StoreInst *S2 = cast<StoreInst>(SPIter);
-						if (S != S2 && S->getPointerOperand() == S2->getPointerOperand()) {
-							removableStore = true;
-							break;
-						}
-					}
-					if (removableStore) {
-						RIL.insert(cast<Instruction>(UserIter));
-						continue;
-					}
-				}
-				matched = false;
-				break;
-			}
-			RIL.insert(I);
-		}
-		if (!matched) continue;
-		// Check Output Registers
-		for (auto &mapIter : ORVM) {
-			Instruction *I = cast<Instruction>(mapIter.second);
-			if (UnRemovable.find(I) != UnRemovable.end()) {
-				matched = false;
-				break;
-			}
-		}
-		if (!matched) continue;
-		// Return
-		InputRegValueMap = IRVM;
-		OutputRegValueMap = ORVM;
-		Removed.insert(RIL.begin(), RIL.end());
-		return matched;
-	}
-	return false;
+	// Run the Compiled Matcher (or Resume it for the Next Binding of the Same Candidate)
+	if (!next) S.reset(Removed, UnRemovable, Type::getInt32Ty(Candidate.front()->getContext()));
+	if (!(S.egraph() != nullptr ? eprogram_ : program_).run(Candidate, S, next)) return false;
+
+	// Return
+	Removed.insert(S.RIL().begin(), S.RIL().end());
+	return true;
 }
 
 } // namespace cca
@@ -1,10 +1,13 @@
 #ifndef PIMCCALLVMPASS_INSTRUMENTATION_CCA_PATTERN_GRAPH_HPP_
 #define PIMCCALLVMPASS_INSTRUMENTATION_CCA_PATTERN_GRAPH_HPP_
 
+#include "Instrumentation/CCAPatternProgram.hpp"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Value.h"
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <ostream>
 #include <set>
 #include <string>
@@ -21,6 +24,16 @@ class CCAPatternGraphCompareNode;
 class CCAPatternGraphSelectNode;
 class CCAPatternGraph;
 
+// Shape of a pattern in preorder: opcode and predicate of each operator, or CCAShapeAny for a register (any value)
+typedef uint32_t CCAShapeKey;
+static const CCAShapeKey CCAShapeAny = 0;
+inline CCAShapeKey makeShapeKey(unsigned opcode, unsigned predicate = 0) { return opcode << 8 | predicate; }
+typedef std::vector<CCAShapeKey> CCAShape;
+
+// Subgraphs visited by a traversal while a pattern graph is built, and operand levels of each register below a root
+typedef std::set<const CCAPatternSubGraph *> CCAVisitSet;
+typedef std::map<std::pair<char, unsigned>, std::set<unsigned>> CCARegisterDepths;
+
 //-------------------------------------------
 // Abstract Class: CCA Pattern Graph Node
 //-------------------------------------------
@@ -31,17 +44,12 @@ class CCAPatternGraphNode {
 	virtual void print(unsigned int indent, std::ostream &os) const = 0;
 	virtual void print(unsigned int indent, llvm::raw_ostream &os) const = 0;
 	virtual unsigned opcode(void) const = 0;
-	virtual void readyForSearch(void) = 0;
-	virtual bool checkValid(void) = 0;
-	virtual bool linkSubgraph(char regtype, unsigned regnum, CCAPatternSubGraph *SG) = 0;
-	virtual unsigned flagsize(void) = 0;
-	virtual void setReverse(const std::vector<bool> &flags, unsigned &index) = 0;
-	virtual bool matchWithCode(Value *StartPoint,
-							   const std::set<Instruction *> &AlreadyRemoved,
-							   std::map<unsigned int, Value *> &IRVM,
-							   std::map<unsigned int, Value *> &ORVM,
-							   std::map<unsigned int, Value *> &TRVM) const = 0;
-	virtual void getRemoveList(Value *StartPoint, User *UserTarget, std::map<Value *, std::set<User *>> &RemoveList) = 0;
+	// Construction (a subgraph linked from several registers is visited once per traversal)
+	virtual bool checkValid(CCAVisitSet &Visited) const = 0;
+	virtual bool linkSubgraph(char regtype, unsigned regnum, CCAPatternSubGraph *SG, CCAVisitSet &Visited) = 0;
+	virtual void getRegisterDepth(unsigned depth, CCARegisterDepths &RDM, CCAVisitSet &Visited) const = 0;
+	virtual void compile(CCAPatternProgram &P, unsigned slot, int userslot) const = 0;
+	virtual void getShapes(unsigned depth, std::vector<CCAShape> &Shapes) const = 0;
 };
 
 //-------------------------------------------
@@ -49,14 +57,13 @@ class CCAPatternGraphNode {
 //-------------------------------------------
 class CCAPatternSubGraph final : public CCAPatternGraphNode {
   private:
-	bool searched_;
 	const char regtype_;
 	const unsigned int regnum_;
 	CCAPatternGraphNode *expr_;
 
   public:
 	CCAPatternSubGraph(char regtype, unsigned regnum, CCAPatternGraphNode *expr)
-		: CCAPatternGraphNode(), searched_(false), regtype_(regtype), regnum_(regnum), expr_(expr) {}
+		: CCAPatternGraphNode(), regtype_(regtype), regnum_(regnum), expr_(expr) {}
 	CCAPatternSubGraph(std::string regstr, CCAPatternGraphNode *expr)
 		: CCAPatternGraphNode(), regtype_(regstr.at(0)), regnum_(std::atoi(regstr.substr(1, std::string::npos).c_str())), expr_(expr) {}
 	virtual ~CCAPatternSubGraph() {
@@ -72,45 +79,29 @@ class CCAPatternSubGraph final : public CCAPatternGraphNode {
 		if (expr_ != nullptr) return expr_->opcode();
 		return Instruction::OtherOpsEnd;
 	}
-	virtual void readyForSearch(void) {
-		searched_ = false;
-		if (expr_ != nullptr) expr_->readyForSearch();
-	}
-	virtual bool checkValid(void) {
-		if (searched_) return true;
-		searched_ = true;
-		if (expr_ != nullptr) return expr_->checkValid();
+	virtual bool checkValid(CCAVisitSet &Visited) const {
+		if (!Visited.insert(this).second) return true;
+		if (expr_ != nullptr) return expr_->checkValid(Visited);
 		return false;
 	}
-	virtual bool linkSubgraph(char regtype, unsigned int regnum, CCAPatternSubGraph *SG) {
-		if (searched_) return false;
-		searched_ = true;
-		if (expr_ != nullptr) return expr_->linkSubgraph(regtype, regnum, SG);
+	virtual bool linkSubgraph(char regtype, unsigned int regnum, CCAPatternSubGraph *SG, CCAVisitSet &Visited) {
+		if (!Visited.insert(this).second) return false;
+		if (expr_ != nullptr) return expr_->linkSubgraph(regtype, regnum, SG, Visited);
 		return false;
 	}
-	virtual unsigned flagsize(void) {
-		if (searched_) return 0;
-		searched_ = true;
-		if (expr_ != nullptr) return expr_->flagsize();
-		return 0;
-	}
-	virtual void setReverse(const std::vector<bool> &flags, unsigned &index) {
-		if (searched_) return;
-		searched_ = true;
-		if (expr_ != nullptr) expr_->setReverse(flags, index);
+	virtual void compile(CCAPatternProgram &P, unsigned slot, int userslot) const {
+		if (expr_ != nullptr) expr_->compile(P, slot, -1);
+		else
+			P.emit(CCAMatchOp::Fail);
 	}
-	virtual bool matchWithCode(Value *StartPoint,
-							   const std::set<Instruction *> &AlreadyRemoved,
-							   std::map<unsigned int, Value *> &IRVM,
-							   std::map<unsigned int, Value *> &ORVM,
-							   std::map<unsigned int, Value *> &TRVM) const {
-		if (expr_ != nullptr) return expr_->matchWithCode(StartPoint, AlreadyRemoved, IRVM, ORVM, TRVM);
-		return false;
+	virtual void getRegisterDepth(unsigned depth, CCARegisterDepths &RDM, CCAVisitSet &Visited) const {
+		if (!Visited.insert(this).second) return;
+		if (expr_ != nullptr) expr_->getRegisterDepth(depth, RDM, Visited);
 	}
-	virtual void getRemoveList(Value *StartPoint, User *UserTarget, std::map<Value *, std::set<User *>> &RemoveList) {
-		if (searched_) return;
-		searched_ = true;
-		if (expr_ != nullptr) expr_->getRemoveList(StartPoint, nullptr, RemoveList);
+	virtual void getShapes(unsigned depth, std::vector<CCAShape> &Shapes) const {
+		if (expr_ != nullptr) expr_->getShapes(depth, Shapes);
+		else
+			for (auto &Shape : Shapes) Shape.push_back(CCAShapeAny);
 	}
 };
 
@@ -131,29 +122,22 @@ class CCAPatternGraphRegisterNode final : public CCAPatternGraphNode {
 	char regtype(void) const { return regtype_; }
 	unsigned regnum(void) const { return regnum_; }
 
-	virtual void readyForSearch(void);
-	virtual bool checkValid(void);
-	virtual bool linkSubgraph(char regtype, unsigned regnum, CCAPatternSubGraph *SG);
-	virtual unsigned flagsize(void);
-	virtual void setReverse(const std::vector<bool> &flags, unsigned &index);
-	virtual bool matchWithCode(Value *StartPoint,
-							   const std::set<Instruction *> &AlreadyRemoved,
-							   std::map<unsigned, Value *> &IRVM,
-							   std::map<unsigned, Value *> &ORVM,
-							   std::map<unsigned, Value *> &TRVM) const;
-	virtual void getRemoveList(Value *StartPoint, User *UserTarget, std::map<Value *, std::set<User *>> &RemoveList);
+	virtual bool checkValid(CCAVisitSet &Visited) const;
+	virtual bool linkSubgraph(char regtype, unsigned regnum, CCAPatternSubGraph *SG, CCAVisitSet &Visited);
+	virtual void compile(CCAPatternProgram &P, unsigned slot, int userslot) const;
+	virtual void getRegisterDepth(unsigned depth, CCARegisterDepths &RDM, CCAVisitSet &Visited) const;
+	virtual void getShapes(unsigned depth, std::vector<CCAShape> &Shapes) const;
 };
 
 class CCAPatternGraphOperatorNode final : public CCAPatternGraphNode {
   private:
 	CCAPatternGraphNode *left_;
 	CCAPatternGraphNode *right_;
-	bool reversed_;
 	std::string op_;
 
   public:
 	CCAPatternGraphOperatorNode(std::string op, CCAPatternGraphNode *left, CCAPatternGraphNode *right)
-		: CCAPatternGraphNode(), left_(left), right_(right), reversed_(false), op_(op) {}
+		: CCAPatternGraphNode(), left_(left), right_(right), op_(op) {}
 	virtual ~CCAPatternGraphOperatorNode() {
 		if (left_ != nullptr) delete left_;
 		left_ = nullptr;
@@ -165,6 +149,7 @@ class CCAPatternGraphOperatorNode final : public CCAPatternGraphNode {
 
 	std::string opstr(void) const { return op_; }
 	bool reversable(void) const { return op_ == "+" || op_ == "*"; }
+	void getACLeaves(std::vector<CCAPatternGraphNode *> &Leaves) const;
 
 	virtual unsigned opcode(void) const {
 		if (op_ == "+") return Instruction::Add;
@@ -177,29 +162,22 @@ class CCAPatternGraphOperatorNode final : public CCAPatternGraphNode {
 		else
 			return Instruction::OtherOpsEnd;
 	}
-	virtual void readyForSearch(void);
-	virtual bool checkValid(void);
-	virtual bool linkSubgraph(char regtype, unsigned regnum, CCAPatternSubGraph *SG);
-	virtual unsigned flagsize(void);
-	virtual void setReverse(const std::vector<bool> &flags, unsigned &index);
-	virtual bool matchWithCode(Value *StartPoint,
-							   const std::set<Instruction *> &AlreadyRemoved,
-							   std::map<unsigned, Value *> &IRVM,
-							   std::map<unsigned, Value *> &ORVM,
-							   std::map<unsigned, Value *> &TRVM) const;
-	virtual void getRemoveList(Value *StartPoint, User *UserTarget, std::map<Value *, std::set<User *>> &RemoveList);
+	virtual bool checkValid(CCAVisitSet &Visited) const;
+	virtual bool linkSubgraph(char regtype, unsigned regnum, CCAPatternSubGraph *SG, CCAVisitSet &Visited);
+	virtual void compile(CCAPatternProgram &P, unsigned slot, int userslot) const;
+	virtual void getRegisterDepth(unsigned depth, CCARegisterDepths &RDM, CCAVisitSet &Visited) const;
+	virtual void getShapes(unsigned depth, std::vector<CCAShape> &Shapes) const;
 };
 
 class CCAPatternGraphCompareNode final : public CCAPatternGraphNode {
   private:
 	CCAPatternGraphNode *left_;
 	CCAPatternGraphNode *right_;
-	bool reversed_;
 	std::string op_;
 
   public:
 	CCAPatternGraphCompareNode(std::string op, CCAPatternGraphNode *left, CCAPatternGraphNode *right)
-		: CCAPatternGraphNode(), left_(left), right_(right), reversed_(false), op_(op) {}
+		: CCAPatternGraphNode(), left_(left), right_(right), op_(op) {}
 	virtual ~CCAPatternGraphCompareNode() {
 		if (left_ != nullptr) delete left_;
 		left_ = nullptr;
@@ -225,19 +203,18 @@ class CCAPatternGraphCompareNode final : public CCAPatternGraphNode {
 			return CmpInst::Predicate::ICMP_SGE;
 		return CmpInst::Predicate::BAD_ICMP_PREDICATE;
 	}
+	// a > b is b < a, so a compare also matches the swapped predicate with swapped operands
+	CmpInst::Predicate swappedPredicate(void) const {
+		CmpInst::Predicate pred = predicate();
+		return pred == CmpInst::Predicate::BAD_ICMP_PREDICATE ? pred : CmpInst::getSwappedPredicate(pred);
+	}
 	bool reversable(void) const { return op_ == "==" || op_ == "!="; }
 
-	virtual void readyForSearch(void);
-	virtual bool checkValid(void);
-	virtual bool linkSubgraph(char regtype, unsigned int regnum, CCAPatternSubGraph *SG);
-	virtual unsigned flagsize(void);
-	virtual void setReverse(const std::vector<bool> &flags, unsigned &index);
-	virtual bool matchWithCode(Value *StartPoint,
-							   const std::set<Instruction *> &AlreadyRemoved,
-							   std::map<unsigned int, Value *> &IRVM,
-							   std::map<unsigned int, Value *> &ORVM,
-							   std::map<unsigned int, Value *> &TRVM) const;
-	virtual void getRemoveList(Value *StartPoint, User *UserTarget, std::map<Value *, std::set<User *>> &RemoveList);
+	virtual bool checkValid(CCAVisitSet &Visited) const;
+	virtual bool linkSubgraph(char regtype, unsigned regnum, CCAPatternSubGraph *SG, CCAVisitSet &Visited);
+	virtual void compile(CCAPatternProgram &P, unsigned slot, int userslot) const;
+	virtual void getRegisterDepth(unsigned depth, CCARegisterDepths &RDM, CCAVisitSet &Visited) const;
+	virtual void getShapes(unsigned depth, std::vector<CCAShape> &Shapes) const;
 };
 
 class CCAPatternGraphSelectNode final : public CCAPatternGraphNode {
@@ -261,28 +238,36 @@ class CCAPatternGraphSelectNode final : public CCAPatternGraphNode {
 	virtual void print(unsigned int indent, llvm::raw_ostream &os) const;
 	virtual unsigned opcode(void) const { return Instruction::Select; }
 
-	virtual void readyForSearch(void);
-	virtual bool checkValid(void);
-	virtual bool linkSubgraph(char regtype, unsigned int regnum, CCAPatternSubGraph *SG);
-	virtual unsigned flagsize(void);
-	virtual void setReverse(const std::vector<bool> &flags, unsigned &index);
-	virtual bool matchWithCode(Value *StartPoint,
-							   const std::set<Instruction *> &AlreadyRemoved,
-							   std::map<unsigned int, Value *> &IRVM,
-							   std::map<unsigned int, Value *> &ORVM,
-							   std::map<unsigned int, Value *> &TRVM) const;
-	virtual void getRemoveList(Value *StartPoint, User *UserTarget, std::map<Value *, std::set<User *>> &RemoveList);
+	virtual bool checkValid(CCAVisitSet &Visited) const;
+	virtual bool linkSubgraph(char regtype, unsigned regnum, CCAPatternSubGraph *SG, CCAVisitSet &Visited);
+	virtual void compile(CCAPatternProgram &P, unsigned slot, int userslot) const;
+	virtual void getRegisterDepth(unsigned depth, CCARegisterDepths &RDM, CCAVisitSet &Visited) const;
+	virtual void getShapes(unsigned depth, std::vector<CCAShape> &Shapes) const;
 };
 
 //-------------------------------------------
 // Class: CCA Pattern Graph
 //-------------------------------------------
+// Use-def path between two output roots sharing a register:
+// the shared value lies `down` operand levels below the anchor root and `up` operand levels below this root
+struct CCAPatternRootLink {
+	bool linked;
+	unsigned anchor;
+	std::set<unsigned> down;
+	std::set<unsigned> up;
+	CCAPatternRootLink() : linked(false), anchor(0), down(), up() {}
+};
 
 class CCAPatternGraph final {
   private:
 	const unsigned rule_number_;
 	std::vector<CCAPatternSubGraph *> graphs_;
 	std::vector<CCAPatternSubGraph *> linked_graphs_;
+	std::vector<CCAPatternRootLink> root_links_;
+	CCAPatternProgram program_;
+	CCAPatternProgram eprogram_; // for matching on an e-graph
+
+	void compile(CCAPatternProgram &P) const;
 
   public:
 	CCAPatternGraph(unsigned rule_number, const std::vector<CCAPatternSubGraph *> SubGraphs);
@@ -304,16 +289,26 @@ class CCAPatternGraph final {
 		for (const auto &SG : linked_graphs_) retval.push_back(std::pair<char, unsigned int>(SG->regtype(), SG->regnum()));
 		return retval;
 	}
+	const std::vector<CCAPatternRootLink> &root_links(void) const { return root_links_; }
+	unsigned root_size(void) const { return linked_graphs_.size(); }
+	std::vector<CCAShape> root_shapes(unsigned gidx) const;
+	const CCAPatternProgram &program(void) const { return program_; }
+	const CCAPatternProgram &eprogram(void) const { return eprogram_; }
+	bool compiled(void) const { return program_.compiled() && eprogram_.compiled(); }
 	unsigned rule_number(void) const { return rule_number_; }
 	void print(unsigned int indent, std::ostream &os) const;
 	void print(unsigned int indent, llvm::raw_ostream &os) const;
 	bool matchWithCode(const std::vector<Instruction *> &Candidate,
 					   const std::set<Instruction *> &UnRemovable,
 					   std::set<Instruction *> &Removed,
-					   std::map<unsigned, Value *> &InputRegValueMap,
-					   std::map<unsigned, Value *> &OutputRegValueMap) const;
+					   CCAMatchState &S,
+					   bool next = false) const;
 };
 
+// A pattern graph is not changed after it is built (the state of a match is in CCAMatchState),
+// so the passes and threads matching a rule share one graph
+typedef std::shared_ptr<const CCAPatternGraph> CCAPatternGraphPtr;
+
 } // namespace cca
 } // namespace llvm
 
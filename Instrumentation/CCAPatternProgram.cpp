@@ -0,0 +1,490 @@
+#include "Instrumentation/CCAPatternProgram.hpp"
+#include "Instrumentation/CCACandidateIndex.hpp"
+#include "Instrumentation/CCADeadStores.hpp"
+#include "Instrumentation/CCAEGraph.hpp"
+#include "Instrumentation/CCAPlacement.hpp"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constant.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instructions.h"
+#include <algorithm>
+#include <iostream>
+
+namespace llvm {
+namespace cca {
+
+// Bound of the instructions moved above the insertion point of a match with its inputs (a match needing more is rejected)
+static const unsigned CCAHoistLimit = 32;
+
+//-------------------------------------------
+// Class: CCA Pattern Program
+//-------------------------------------------
+// Compile Interfaces
+unsigned CCAPatternProgram::newSlot(void) {
+	if (slotsize_ > UINT8_MAX && error_.empty()) error_ = "more than " + std::to_string(UINT8_MAX + 1) + " slots";
+	return slotsize_++;
+}
+
+unsigned CCAPatternProgram::regIndex(char regtype, unsigned int regnum) {
+	for (unsigned idx = 0; idx < regs_.size(); ++idx)
+		if (regs_[idx].first == regtype && regs_[idx].second == regnum) return idx;
+	if (regs_.size() >= CCAMatchState::MaxRegs && error_.empty()) error_ = "more than " + std::to_string(CCAMatchState::MaxRegs) + " registers";
+	regs_.push_back({regtype, regnum});
+	return regs_.size() - 1;
+}
+
+unsigned CCAPatternProgram::emit(CCAMatchOp::Kind kind, unsigned a, unsigned b, unsigned c, uint32_t imm, unsigned d) {
+	if (std::max({a, b, c, d}) > UINT8_MAX && error_.empty()) error_ = "an operand exceeds " + std::to_string(UINT8_MAX);
+	ops_.push_back({kind, (uint8_t)a, (uint8_t)b, (uint8_t)c, (uint8_t)d, imm});
+	return ops_.size() - 1;
+}
+
+// Check the Program Records Removals only for a Single AC Chain (its interior nodes, and the chain as the operand of its user)
+// Then an interior node which cannot be removed with the cut of the chain fails every assignment of the leaves of the cut.
+bool CCAPatternProgram::isolatedAC(void) const {
+	unsigned chains = 0, chain = 0;
+	for (const CCAMatchOp &Op : ops_)
+		if (Op.kind == CCAMatchOp::MatchAC) ++chains, chain = Op.a;
+	if (chains != 1) return false;
+	for (const CCAMatchOp &Op : ops_)
+		if (Op.kind == CCAMatchOp::RecordRemove && Op.a != chain) return false;
+	return true;
+}
+
+// Run Program
+// On a failed operation, the search resumes from the last choice point with its next alternative.
+// With resume, the previous accepted match is rejected to search the next binding of the same candidate.
+bool CCAPatternProgram::run(const std::vector<Instruction *> &Candidate, CCAMatchState &S, bool resume) const {
+	if (!compiled()) return false;
+	const CCAEGraph *EG = S.egraph();
+	unsigned pc = 0;
+	if (resume && !S.backtrack(pc)) return false;
+	while (true) {
+		const CCAMatchOp &Op = ops_[pc++];
+		bool matched = true;
+		switch (Op.kind) {
+		case CCAMatchOp::LoadRoot:
+			S.slot(Op.a) = Candidate[Op.imm];
+			if (EG != nullptr) matched = (S.eslot(Op.a) = EG->classOf(Candidate[Op.imm])) != CCAEGraph::None;
+			break;
+		case CCAMatchOp::LoadOperand:
+			if (EG != nullptr) {
+				S.eslot(Op.a) = EG->node(S.enode(Op.b)).ops[Op.c];
+				S.slot(Op.a) = EG->leader(S.eslot(Op.a));
+			} else
+				S.slot(Op.a) = cast<User>(S.slot(Op.b))->getOperand(Op.c);
+			break;
+		case CCAMatchOp::CheckBinOp: {
+			if (EG != nullptr) {
+				matched = S.chooseNode(pc - 1, Op.a, Op.imm, 0, 0);
+				break;
+			}
+			Value *V = S.slot(Op.a);
+			matched = isa<BinaryOperator>(V) && cast<BinaryOperator>(V)->getOpcode() == Op.imm;
+			break;
+		}
+		case CCAMatchOp::CheckICmp: {
+			if (EG != nullptr) {
+				matched = S.chooseNode(pc - 1, Op.a, Instruction::ICmp, Op.imm, Op.c);
+				break;
+			}
+			Value *V = S.slot(Op.a);
+			if (!isa<ICmpInst>(V)) matched = false;
+			else {
+				CmpInst::Predicate Pred = cast<ICmpInst>(V)->getPredicate();
+				matched = Pred == Op.imm || Pred == Op.c;
+			}
+			break;
+		}
+		case CCAMatchOp::CheckSelect:
+			if (EG != nullptr) matched = S.chooseNode(pc - 1, Op.a, Instruction::Select, 0, 0);
+			else
+				matched = isa<SelectInst>(S.slot(Op.a));
+			break;
+		case CCAMatchOp::CheckRegister: matched = S.slot(Op.a) != nullptr && S.isRegisterValue(S.slot(Op.a)); break;
+		case CCAMatchOp::TrySwap: {
+			unsigned alt = S.enterChoice(pc - 1);
+			if (alt == 1) S.swapSlots(Op.a, Op.b);
+			else if (alt > 1) {
+				S.popChoice();
+				matched = false;
+			}
+			break;
+		}
+		case CCAMatchOp::SwapIfPred: {
+			unsigned Pred = EG != nullptr ? EG->node(S.enode(Op.c)).pred : (unsigned)cast<ICmpInst>(S.slot(Op.c))->getPredicate();
+			if (Pred == Op.imm) S.swapSlots(Op.a, Op.b);
+			break;
+		}
+		case CCAMatchOp::MatchAC: matched = S.matchAC(pc - 1, Op); break;
+		case CCAMatchOp::BindRegister: {
+			Value *B = S.binding(Op.b);
+			if (B == nullptr) S.bind(Op.b, S.slot(Op.a));
+			else
+				matched = B == S.slot(Op.a);
+			break;
+		}
+		case CCAMatchOp::BindLinked: {
+			Value *B = S.binding(Op.b);
+			if (B == nullptr) S.bind(Op.b, S.slot(Op.a));
+			else if (B == S.slot(Op.a))
+				pc = Op.imm;
+			else
+				matched = false;
+			break;
+		}
+		case CCAMatchOp::RecordRemove:
+			if (EG == nullptr) S.addRemove(S.slot(Op.a), cast<User>(S.slot(Op.b)));
+			break;
+		case CCAMatchOp::Fail: matched = false; break;
+		case CCAMatchOp::Accept:
+			if (S.accept()) return true;
+			matched = false;
+			break;
+		}
+		if (!matched && !S.backtrack(pc)) return false;
+	}
+}
+
+//-------------------------------------------
+// Class: CCA Match State
+//-------------------------------------------
+// Constructor
+CCAMatchState::CCAMatchState(const CCAPatternProgram &P)
+	: P_(P), isolatedAC_(P.isolatedAC()), EG_(nullptr), Index_(nullptr), DeadStores_(nullptr), Placement_(nullptr), Hoisted_(nullptr), overhead_(0), InsertPos_(nullptr),
+	  AlreadyRemoved_(nullptr), UnRemovable_(nullptr), Int32Ty_(nullptr), slots_(P.slotsize(), nullptr),
+	  eslots_(P.slotsize(), 0), enodes_(P.slotsize(), 0), binds_(), bound_(0), bindTrail_(), removeTrail_(), removeSorted_(), choices_(),
+	  resuming_(false), ac_(P.acsize()), frontier_(), interior_(), cone_(), work_(), hoisted_(), RIL_(), outputs_(), moved_(), inputs_() {
+	bindTrail_.reserve(P.regs().size());
+	removeTrail_.reserve(P.slotsize());
+	removeSorted_.reserve(P.slotsize());
+	choices_.reserve(P.slotsize());
+	frontier_.reserve(P.slotsize());
+	interior_.reserve(P.slotsize());
+	RIL_.reserve(2 * P.slotsize());
+}
+
+// Check Value can be Held in a Register
+bool CCAMatchState::isRegisterValue(Value *V) const {
+	// Check Type
+	if (V->getType() != Int32Ty_) return false;
+	// Already Removed or Matched (constants are only moved in on an e-graph, where they come from rewrites)
+	if (isa<Constant>(V)) return EG_ != nullptr && isa<ConstantInt>(V);
+	if (isa<Instruction>(V) && AlreadyRemoved_->find(cast<Instruction>(V)) != AlreadyRemoved_->end()) return false;
+	return true;
+}
+
+// Restore the Last Choice Point, and Re-execute it with its Next Alternative
+bool CCAMatchState::backtrack(unsigned &pc) {
+	if (choices_.empty()) return false;
+	Choice &C = choices_.back();
+	while (bindTrail_.size() > C.bindmark) {
+		bound_ &= ~((uint64_t)1 << bindTrail_.back());
+		bindTrail_.pop_back();
+	}
+	removeTrail_.resize(C.removemark);
+	++C.alt;
+	pc = C.pc;
+	resuming_ = true;
+	return true;
+}
+
+// Enumerate the Cuts of an AC Chain into the Given Number of Leaves
+// The frontier holds the leaves in order; each position is either kept as a leaf or flattened into its two operands
+// when it is the same operator (in the same block, unless BB is null), so every cut is generated once with its leaves left to right.
+void CCAMatchState::flattenAC(unsigned pos, BasicBlock *BB, unsigned opcode, unsigned leaves, ACScratch &AC) {
+	if (pos == frontier_.size()) {
+		if (frontier_.size() != leaves) return;
+		AC.cuts.insert(AC.cuts.end(), frontier_.begin(), frontier_.end());
+		AC.cuts.insert(AC.cuts.end(), interior_.begin(), interior_.end());
+		return;
+	}
+	// Keep as a Leaf
+	flattenAC(pos + 1, BB, opcode, leaves, AC);
+	// Flatten into the Operands
+	std::pair<Value *, User *> Item = frontier_[pos];
+	BinaryOperator *BO = dyn_cast<BinaryOperator>(Item.first);
+	if (BO == nullptr || BO->getOpcode() != opcode || (BB != nullptr && BO->getParent() != BB) || frontier_.size() >= leaves) return;
+	interior_.push_back(Item);
+	frontier_[pos] = {BO->getOperand(0), BO};
+	frontier_.insert(frontier_.begin() + pos + 1, {BO->getOperand(1), BO});
+	flattenAC(pos, BB, opcode, leaves, AC);
+	frontier_.erase(frontier_.begin() + pos + 1);
+	frontier_[pos] = Item;
+	interior_.pop_back();
+}
+
+// Step to the Next Distinct Assignment of the Current Cut (Equal Leaves are not Permuted)
+// The permutation starts at the leaf order of the cut and wraps around, so the first assignment is the one of the binary matcher.
+bool CCAMatchState::nextPermAC(ACScratch &AC, unsigned leaves) const {
+	const std::pair<Value *, User *> *Cut = &AC.cuts[AC.cut * (2 * leaves - 2)];
+	auto Less = [Cut](unsigned x, unsigned y) { return Cut[x].first < Cut[y].first; };
+	auto Same = [Cut](unsigned x, unsigned y) { return Cut[x].first == Cut[y].first; };
+	std::next_permutation(AC.perm.begin(), AC.perm.end(), Less);
+	return !std::equal(AC.perm.begin(), AC.perm.end(), AC.first.begin(), Same);
+}
+
+// Check the Interior Nodes of the Current Cut can be Removed, as accept() does with the remove list of the cut
+bool CCAMatchState::isRemovableCut(const ACScratch &AC, unsigned leaves) const {
+	unsigned stride = 2 * leaves - 2;
+	const std::pair<Value *, User *> *Cut = &AC.cuts[AC.cut * stride];
+	for (unsigned idx = leaves; idx < stride; ++idx) {
+		Instruction *I = cast<Instruction>(Cut[idx].first);
+		if (isPinned(I)) return false;
+		for (auto UserIter : I->users()) {
+			if (std::find(Cut + leaves, Cut + stride, std::pair<Value *, User *>(I, UserIter)) != Cut + stride) continue;
+			if (!isOverwrittenStore(UserIter)) return false;
+		}
+	}
+	return true;
+}
+
+// Try the Next Assignment of the Leaves of an AC Chain
+// A cut whose interior nodes cannot be removed is skipped with all its assignments, when nothing else can remove them.
+bool CCAMatchState::matchAC(unsigned pc, const CCAMatchOp &Op) {
+	unsigned leaves = Op.b, stride = 2 * leaves - 2;
+	ACScratch &AC = ac_[Op.d];
+	unsigned alt = enterChoice(pc);
+	bool newcut = alt == 0;
+	if (alt == 0) {
+		BinaryOperator *Root = cast<BinaryOperator>(slots_[Op.a]);
+		AC.cuts.clear();
+		frontier_.assign({{Root->getOperand(0), Root}, {Root->getOperand(1), Root}});
+		interior_.clear();
+		flattenAC(0, Placement_ == nullptr ? Root->getParent() : nullptr, Op.imm, leaves, AC);
+		AC.cut = 0;
+		AC.ncut = AC.cuts.size() / stride;
+	} else if (!nextPermAC(AC, leaves)) {
+		++AC.cut;
+		newcut = true;
+	}
+	while (newcut && isolatedAC_ && AC.cut < AC.ncut && !isRemovableCut(AC, leaves)) ++AC.cut;
+	if (AC.cut >= AC.ncut) {
+		popChoice();
+		return false;
+	}
+	if (newcut) {
+		AC.perm.resize(leaves);
+		for (unsigned idx = 0; idx < leaves; ++idx) AC.perm[idx] = idx;
+		AC.first.assign(AC.perm.begin(), AC.perm.end());
+	}
+	// Assign Leaves and Record Interior Nodes
+	const std::pair<Value *, User *> *Cut = &AC.cuts[AC.cut * stride];
+	for (unsigned idx = 0; idx < leaves; ++idx) {
+		slots_[Op.c + idx] = Cut[AC.perm[idx]].first;
+		slots_[Op.c + leaves + idx] = Cut[AC.perm[idx]].second;
+	}
+	for (unsigned idx = leaves; idx < stride; ++idx) addRemove(Cut[idx].first, Cut[idx].second);
+	return true;
+}
+
+// Check a User is a Dead Store by MemorySSA and Alias Analysis, or without them, a Store Overwritten by a Later Store
+// to the Same Pointer in its Block with no Read between them (looked up in the candidate index, or scanned without it)
+bool CCAMatchState::isOverwrittenStore(User *U) const {
+	if (!isa<StoreInst>(U)) return false;
+	StoreInst *S = cast<StoreInst>(U);
+	if (DeadStores_ != nullptr) return DeadStores_->isDead(S);
+	if (Index_ != nullptr) return Index_->getNextStore(S) != nullptr;
+	return CCACandidateIndex::findNextStore(S) != nullptr;
+}
+
+// Check a Load and a Store Access Disjoint Bytes at Constant Offsets from the Same Pointer
+static bool isDisjoint(const LoadInst *L, const StoreInst *S) {
+	const DataLayout &DL = L->getModule()->getDataLayout();
+	APInt LOff(DL.getIndexTypeSizeInBits(L->getPointerOperandType()), 0), SOff(DL.getIndexTypeSizeInBits(S->getPointerOperandType()), 0);
+	if (LOff.getBitWidth() != SOff.getBitWidth()) return false;
+	const Value *LBase = L->getPointerOperand()->stripAndAccumulateConstantOffsets(DL, LOff, true);
+	const Value *SBase = S->getPointerOperand()->stripAndAccumulateConstantOffsets(DL, SOff, true);
+	if (LBase != SBase) return false;
+	const int64_t l = LOff.getSExtValue(), s = SOff.getSExtValue();
+	return l + (int64_t)DL.getTypeStoreSize(L->getType()) <= s || s + (int64_t)DL.getTypeStoreSize(S->getValueOperand()->getType()) <= l;
+}
+
+// Check an Instruction Reading Memory or Unsafe to Speculate can Move from its Place up to Pos: no instruction between them
+// has side effects, but the simple stores disjoint from a simple load
+static bool canHoistAcross(Instruction *Pos, Instruction *I) {
+	const LoadInst *L = dyn_cast<LoadInst>(I);
+	for (Instruction *X = Pos; X != I; X = X->getNextNode()) {
+		if (!X->mayHaveSideEffects()) continue;
+		const StoreInst *S = dyn_cast<StoreInst>(X);
+		if (L == nullptr || !L->isSimple() || S == nullptr || !S->isSimple() || !isDisjoint(L, S)) return false;
+	}
+	return true;
+}
+
+// Check the Inputs of a Match in its Block Precede the Insertion Point (the first output), as CCAPlacement::place checks
+// across blocks. An input after it is moved above it by reorderBlock with the operands it needs there, so these must not
+// depend on an output (of this match, or of an earlier one: UnRemovable) or have side effects, and the ones reading memory
+// or unsafe to speculate must not cross a store they may read or another instruction with side effects on their way up.
+// The moved instructions are kept in hoisted_, as a later match may not replace them (see isPinned).
+bool CCAMatchState::precedesInsertion(BasicBlock *BB) {
+	Instruction *Pos = nullptr;
+	for (unsigned reg = 0; reg < P_.regs().size(); ++reg) {
+		if (P_.regs()[reg].first != 'o' || !isa_and_nonnull<Instruction>(binding(reg))) continue;
+		Instruction *I = cast<Instruction>(binding(reg));
+		if (I->getParent() == BB && (Pos == nullptr || I->comesBefore(Pos))) Pos = I;
+	}
+	if (Pos == nullptr) return true;
+	hoisted_.clear();
+	work_.clear();
+	for (unsigned reg = 0; reg < P_.regs().size(); ++reg)
+		if (P_.regs()[reg].first == 'i' && binding(reg) != nullptr) work_.push_back(binding(reg));
+	while (!work_.empty()) {
+		Instruction *I = dyn_cast<Instruction>(work_.back());
+		work_.pop_back();
+		if (I == nullptr || I->getParent() != BB || I->comesBefore(Pos)) continue;
+		if (std::find(hoisted_.begin(), hoisted_.end(), I) != hoisted_.end()) continue;
+		if (I == Pos || isa<PHINode>(I) || I->mayHaveSideEffects() || isBound(I, 'o') || UnRemovable_->count(I)) return false;
+		if ((I->mayReadFromMemory() || !isSafeToSpeculativelyExecute(I)) && !canHoistAcross(Pos, I)) return false;
+		if (hoisted_.size() == CCAHoistLimit) return false;
+		hoisted_.push_back(I);
+		work_.insert(work_.end(), I->op_begin(), I->op_end());
+	}
+	return true;
+}
+
+// Check an Instruction cannot be Removed or Replaced by the Match: an earlier match replaces it, or moves it above its
+// insertion point (where the replaced value would not be defined yet)
+bool CCAMatchState::isPinned(Instruction *I) const {
+	return UnRemovable_->find(I) != UnRemovable_->end() || (Hoisted_ != nullptr && Hoisted_->find(I) != Hoisted_->end());
+}
+
+// Check a Value is Bound to a Register of the Type
+bool CCAMatchState::isBound(Value *V, char regtype) const {
+	for (unsigned reg = 0; reg < P_.regs().size(); ++reg)
+		if (P_.regs()[reg].first == regtype && binding(reg) == V) return true;
+	return false;
+}
+
+// Choose the Next Node of the Class in a Slot with the Opcode (and Predicate or Swapped Predicate)
+bool CCAMatchState::chooseNode(unsigned pc, unsigned slot, unsigned opcode, unsigned pred, unsigned swapped) {
+	unsigned alt = enterChoice(pc), seen = 0;
+	for (unsigned n : EG_->members(eslots_[slot])) {
+		const CCAENode &N = EG_->node(n);
+		if (N.opcode != opcode || (N.pred != pred && N.pred != swapped)) continue;
+		if (seen++ < alt) continue;
+		enodes_[slot] = n;
+		return true;
+	}
+	popChoice();
+	return false;
+}
+
+// Check the Matched Codes are Removable on an E-Graph
+// The nodes of a match need not be instructions, so the code removed is the cone of the outputs down to the inputs:
+// every instruction of the block reached from the outputs without passing an input, all of whose users are in the cone.
+// An input is the leader of its class, which may be defined after the outputs, so it is checked as in accept().
+bool CCAMatchState::acceptCone(void) {
+	RIL_.clear();
+	cone_.clear();
+	work_.clear();
+	BasicBlock *parent = nullptr;
+	for (unsigned reg = 0; reg < P_.regs().size(); ++reg) {
+		if (P_.regs()[reg].first != 'o' || binding(reg) == nullptr) continue;
+		Instruction *I = dyn_cast<Instruction>(binding(reg));
+		if (I == nullptr || (parent != nullptr && parent != I->getParent())) return false;
+		if (isPinned(I)) return false;
+		parent = I->getParent();
+		work_.insert(work_.end(), I->op_begin(), I->op_end());
+	}
+	while (!work_.empty()) {
+		Instruction *I = dyn_cast<Instruction>(work_.back());
+		work_.pop_back();
+		if (I == nullptr || I->getParent() != parent || isa<PHINode>(I) || isBound(I, 'i') || isBound(I, 'o')) continue;
+		if (std::find(cone_.begin(), cone_.end(), I) != cone_.end()) continue;
+		if (isPinned(I) || AlreadyRemoved_->find(I) != AlreadyRemoved_->end()) return false;
+		cone_.push_back(I);
+		work_.insert(work_.end(), I->op_begin(), I->op_end());
+	}
+	for (Instruction *I : cone_) {
+		for (auto UserIter : I->users()) {
+			if (std::find(cone_.begin(), cone_.end(), UserIter) != cone_.end() || isBound(UserIter, 'o')) continue;
+			if (isOverwrittenStore(UserIter)) {
+				RIL_.push_back(cast<Instruction>(UserIter));
+				continue;
+			}
+			return false;
+		}
+		RIL_.push_back(I);
+	}
+	return parent == nullptr || precedesInsertion(parent);
+}
+
+// Check the Matched Codes are Removable
+bool CCAMatchState::accept(void) {
+	InsertPos_ = nullptr;
+	hoisted_.clear();
+	if (EG_ != nullptr) return acceptCone();
+	// Group the Remove List by Value (the trail itself is kept in order for backtracking)
+	removeSorted_.assign(removeTrail_.begin(), removeTrail_.end());
+	std::sort(removeSorted_.begin(), removeSorted_.end());
+	// Check Remove Lists
+	RIL_.clear();
+	BasicBlock *parent = nullptr;
+	bool spanning = false;
+	for (auto GroupBegin = removeSorted_.begin(); GroupBegin != removeSorted_.end();) {
+		auto GroupEnd = GroupBegin;
+		while (GroupEnd != removeSorted_.end() && GroupEnd->first == GroupBegin->first) ++GroupEnd;
+		// if(!isa<Instruction>(GroupBegin->first)) /* error */
+		Instruction *I = cast<Instruction>(GroupBegin->first);
+		// Check Instructions are Removable
+		if (isPinned(I)) return false;
+		// Check Instructions came from same Parent
+		if (parent == nullptr) parent = I->getParent();
+		else if (parent != I->getParent()) {
+			if (Placement_ == nullptr) return false;
+			spanning = true;
+		}
+		// Check Users of Instructions to be Removed
+		for (auto UserIter : I->users()) {
+			if (std::binary_search(GroupBegin, GroupEnd, std::pair<Value *, User *>(I, UserIter))) continue;
+			if (isOverwrittenStore(UserIter)) {
+				RIL_.push_back(cast<Instruction>(UserIter));
+				continue;
+			}
+			return false;
+		}
+		RIL_.push_back(I);
+		GroupBegin = GroupEnd;
+	}
+	// Check Output Registers
+	for (unsigned reg = 0; reg < P_.regs().size(); ++reg) {
+		if (P_.regs()[reg].first != 'o' || binding(reg) == nullptr) continue;
+		Instruction *I = cast<Instruction>(binding(reg));
+		if (isPinned(I)) return false;
+		if (parent == nullptr) parent = I->getParent();
+		else if (parent != I->getParent()) {
+			if (Placement_ == nullptr) return false;
+			spanning = true;
+		}
+	}
+	if (spanning) return placeSpanning();
+	return parent == nullptr || precedesInsertion(parent);
+}
+
+// Place a Match Spanning Blocks
+bool CCAMatchState::placeSpanning(void) {
+	outputs_.clear();
+	moved_.clear();
+	inputs_.clear();
+	for (unsigned reg = 0; reg < P_.regs().size(); ++reg) {
+		if (binding(reg) == nullptr) continue;
+		if (P_.regs()[reg].first == 'o') outputs_.push_back(cast<Instruction>(binding(reg)));
+		else if (P_.regs()[reg].first == 'i')
+			inputs_.push_back(binding(reg));
+	}
+	moved_.assign(outputs_.begin(), outputs_.end());
+	for (Instruction *I : RIL_)
+		if (!isa<StoreInst>(I)) moved_.push_back(I);
+	InsertPos_ = Placement_->place(outputs_, moved_, inputs_, overhead_);
+	return InsertPos_ != nullptr;
+}
+
+// Get Bound Values of Registers
+void CCAMatchState::getRegValueMap(char regtype, std::map<unsigned int, Value *> &RVM) const {
+	for (unsigned reg = 0; reg < P_.regs().size(); ++reg)
+		if (P_.regs()[reg].first == regtype && binding(reg) != nullptr) RVM[P_.regs()[reg].second] = binding(reg);
+}
+
+} // namespace cca
+} // namespace llvm
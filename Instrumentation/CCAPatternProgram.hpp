@@ -0,0 +1,215 @@
+#ifndef PIMCCALLVMPASS_INSTRUMENTATION_CCA_PATTERN_PROGRAM_HPP_
+#define PIMCCALLVMPASS_INSTRUMENTATION_CCA_PATTERN_PROGRAM_HPP_
+
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Value.h"
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+namespace cca {
+
+class CCAMatchState;
+class CCAEGraph;
+class CCACandidateIndex;
+class CCADeadStores;
+class CCAPlacement;
+
+//-------------------------------------------
+// Struct: CCA Match Operation
+//-------------------------------------------
+// One instruction of a compiled pattern: a, b, c and d are slot / register / operand / scratch indices, imm is an opcode,
+// predicate, root index or jump target depending on the kind
+struct CCAMatchOp {
+	enum Kind : uint8_t {
+		LoadRoot,	   // slot[a] = candidate root [imm]
+		LoadOperand,   // slot[a] = operand c of slot[b] (of the node chosen for slot[b] on an e-graph)
+		CheckBinOp,	   // slot[a] is a binary operator with opcode imm
+		CheckICmp,	   // slot[a] is an icmp with predicate imm or its swapped predicate c
+		CheckSelect,   // slot[a] is a select
+		CheckRegister, // slot[a] is a non-constant i32 value which is not removed yet
+		TrySwap,	   // choice point: continue, and retry with slot[a] and slot[b] swapped on failure
+		SwapIfPred,	   // swap slot[a] and slot[b] if the icmp slot[c] has predicate imm (the swapped form of the pattern)
+		MatchAC,	   // choice point: flatten the chain of opcode imm at slot[a] into b leaves (AC scratch d), then try each
+					   // assignment of the leaves to slot[c..c+b) with their users in slot[c+b..c+2b)
+		BindRegister,  // bind register b to slot[a], or check the bound value is the same
+		BindLinked,	   // same as BindRegister, but jump to imm (skipping the linked subgraph) if already bound
+		RecordRemove,  // slot[a] is removed, and slot[b] is its user in the pattern (ignored on an e-graph)
+		Fail,		   // always fail
+		Accept		   // check removability of the matched codes, and finish
+	};
+	Kind kind;
+	uint8_t a, b, c, d;
+	uint32_t imm;
+};
+
+//-------------------------------------------
+// Class: CCA Pattern Program
+//-------------------------------------------
+// Flat matcher compiled from a pattern graph, interpreted with an explicit backtracking stack.
+// On an e-graph, a slot holds a class, and each check is a choice point over the nodes of the class.
+class CCAPatternProgram final {
+  private:
+	std::vector<CCAMatchOp> ops_;
+	std::vector<std::pair<char, unsigned int>> regs_;
+	std::set<unsigned> open_; // registers whose linked subgraph is being compiled
+	unsigned slotsize_;
+	unsigned acsize_;
+	const bool egraph_; // compiled for matching on an e-graph (chains are matched node by node)
+	std::string error_; // why the pattern cannot be compiled (operands are 8-bit, and bindings a 64-bit mask)
+
+  public:
+	CCAPatternProgram(bool egraph = false) : ops_(), regs_(), open_(), slotsize_(0), acsize_(0), egraph_(egraph), error_() {}
+
+	// Compile Interfaces
+	unsigned newSlot(void);
+	unsigned regIndex(char regtype, unsigned int regnum);
+	unsigned newACScratch(void) { return acsize_++; }
+	unsigned emit(CCAMatchOp::Kind kind, unsigned a = 0, unsigned b = 0, unsigned c = 0, uint32_t imm = 0, unsigned d = 0);
+	void patch(unsigned at, uint32_t imm) { ops_.at(at).imm = imm; }
+	void open(unsigned reg, bool opened) { opened ? (void)open_.insert(reg) : (void)open_.erase(reg); }
+	bool isOpen(unsigned reg) const { return open_.find(reg) != open_.end(); }
+	unsigned size(void) const { return ops_.size(); }
+	bool egraph(void) const { return egraph_; }
+	// A program which failed to compile is never run
+	bool compiled(void) const { return error_.empty(); }
+	const std::string &error(void) const { return error_; }
+
+	// Match Interfaces
+	unsigned slotsize(void) const { return slotsize_; }
+	unsigned acsize(void) const { return acsize_; }
+	const std::vector<std::pair<char, unsigned int>> &regs(void) const { return regs_; }
+	bool isolatedAC(void) const;
+	bool run(const std::vector<Instruction *> &Candidate, CCAMatchState &S, bool resume = false) const;
+};
+
+//-------------------------------------------
+// Class: CCA Match State
+//-------------------------------------------
+// Slots, register bindings and remove list of one match attempt with undo trails for backtracking.
+// A state is created once per program and reset for each candidate, so an attempt does not allocate:
+// bindings are a fixed table indexed by register with a bitmask of bound registers, and all buffers keep their capacity.
+class CCAMatchState final {
+  public:
+	static constexpr unsigned MaxRegs = 64;
+
+  private:
+	// A choice point re-executes the operation at pc with the next alternative
+	struct Choice {
+		unsigned pc;
+		unsigned alt;
+		unsigned bindmark, removemark;
+	};
+	// Flattened chains of an AC operation: each cut is its leaves followed by its interior nodes, with their users
+	struct ACScratch {
+		std::vector<std::pair<Value *, User *>> cuts;
+		unsigned cut, ncut;
+		std::vector<unsigned> perm, first;
+	};
+	const CCAPatternProgram &P_;
+	const bool isolatedAC_; // the interior nodes of the chain are removed with no help from the rest of the pattern
+	const CCAEGraph *EG_;
+	const CCACandidateIndex *Index_;
+	const CCADeadStores *DeadStores_;
+	const CCAPlacement *Placement_; // matches spanning blocks are placed by it (without it, a match is in one block)
+	const std::set<Instruction *> *Hoisted_; // by the earlier matches (none for a tentative match)
+	int overhead_;					// cycles of the cca site of the rule, which a placed match must save
+	Instruction *InsertPos_;
+	const std::set<Instruction *> *AlreadyRemoved_;
+	const std::set<Instruction *> *UnRemovable_;
+	Type *Int32Ty_;
+	std::vector<Value *> slots_;
+	std::vector<unsigned> eslots_, enodes_; // class and chosen node of each slot on an e-graph
+	Value *binds_[MaxRegs];
+	uint64_t bound_;
+	std::vector<uint8_t> bindTrail_;
+	std::vector<std::pair<Value *, User *>> removeTrail_;
+	std::vector<std::pair<Value *, User *>> removeSorted_;
+	std::vector<Choice> choices_;
+	bool resuming_;
+	std::vector<ACScratch> ac_;
+	std::vector<std::pair<Value *, User *>> frontier_, interior_;
+	std::vector<Instruction *> cone_;
+	std::vector<Value *> work_;
+	std::vector<Instruction *> hoisted_; // instructions after the insertion point which the inputs need
+	std::vector<Instruction *> RIL_;
+	std::vector<Instruction *> outputs_, moved_;
+	std::vector<Value *> inputs_;
+
+	void flattenAC(unsigned pos, BasicBlock *BB, unsigned opcode, unsigned leaves, ACScratch &AC);
+	bool nextPermAC(ACScratch &AC, unsigned leaves) const;
+	bool isRemovableCut(const ACScratch &AC, unsigned leaves) const;
+	bool isBound(Value *V, char regtype) const;
+	bool isPinned(Instruction *I) const;
+	bool isOverwrittenStore(User *U) const;
+	bool precedesInsertion(BasicBlock *BB);
+	bool acceptCone(void);
+	bool placeSpanning(void);
+
+  public:
+	CCAMatchState(const CCAPatternProgram &P);
+
+	void reset(const std::set<Instruction *> &AlreadyRemoved, const std::set<Instruction *> &UnRemovable, Type *Int32Ty) {
+		AlreadyRemoved_ = &AlreadyRemoved;
+		UnRemovable_ = &UnRemovable;
+		Int32Ty_ = Int32Ty;
+		bound_ = 0;
+		bindTrail_.clear();
+		removeTrail_.clear();
+		choices_.clear();
+		resuming_ = false;
+		RIL_.clear();
+		InsertPos_ = nullptr;
+	}
+	void setEGraph(const CCAEGraph *EG) { EG_ = EG; }
+	void setIndex(const CCACandidateIndex *Index) { Index_ = Index; }
+	void setDeadStores(const CCADeadStores *DeadStores) { DeadStores_ = DeadStores; }
+	void setHoisted(const std::set<Instruction *> *Hoisted) { Hoisted_ = Hoisted; }
+	void setPlacement(const CCAPlacement *Placement, int overhead) {
+		Placement_ = Placement;
+		overhead_ = overhead;
+	}
+	const CCAEGraph *egraph(void) const { return EG_; }
+	Value *&slot(unsigned idx) { return slots_[idx]; }
+	unsigned &eslot(unsigned idx) { return eslots_[idx]; }
+	unsigned enode(unsigned idx) const { return enodes_[idx]; }
+	void swapSlots(unsigned a, unsigned b) {
+		std::swap(slots_[a], slots_[b]);
+		std::swap(eslots_[a], eslots_[b]);
+	}
+	bool isRegisterValue(Value *V) const;
+	Value *binding(unsigned reg) const { return (bound_ >> reg & 1) ? binds_[reg] : nullptr; }
+	void bind(unsigned reg, Value *V) {
+		binds_[reg] = V;
+		bound_ |= (uint64_t)1 << reg;
+		bindTrail_.push_back(reg);
+	}
+	void addRemove(Value *V, User *U) { removeTrail_.push_back({V, U}); }
+	unsigned enterChoice(unsigned pc) {
+		if (resuming_) {
+			resuming_ = false;
+			return choices_.back().alt;
+		}
+		choices_.push_back({pc, 0, (unsigned)bindTrail_.size(), (unsigned)removeTrail_.size()});
+		return 0;
+	}
+	void popChoice(void) { choices_.pop_back(); }
+	bool backtrack(unsigned &pc);
+	bool matchAC(unsigned pc, const CCAMatchOp &Op);
+	bool chooseNode(unsigned pc, unsigned slot, unsigned opcode, unsigned pred, unsigned swapped);
+	bool accept(void);
+
+	void getRegValueMap(char regtype, std::map<unsigned int, Value *> &RVM) const;
+	const std::vector<Instruction *> &RIL(void) const { return RIL_; }
+	Instruction *insertPoint(void) const { return InsertPos_; }
+	const std::vector<Instruction *> &hoisted(void) const { return hoisted_; }
+};
+
+} // namespace cca
+} // namespace llvm
+
+#endif // PIMCCALLVMPASS_INSTRUMENTATION_CCA_PATTERN_PROGRAM_HPP_
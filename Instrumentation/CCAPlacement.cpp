@@ -0,0 +1,50 @@
+#include "Instrumentation/CCAPlacement.hpp"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/BasicBlock.h"
+
+namespace llvm {
+namespace cca {
+
+//-------------------------------------
+// Class: CCA Placement
+//-------------------------------------
+int CCAPlacement::estimateCycles(const Instruction *I) {
+	switch (I->getOpcode()) {
+	case Instruction::Mul: return 32;
+	case Instruction::UDiv:
+	case Instruction::SDiv:
+	case Instruction::URem:
+	case Instruction::SRem: return 64;
+	default: return 1;
+	}
+}
+
+// Find the Insertion Point of a Match (nullptr if it cannot be placed, or is not profitable)
+Instruction *CCAPlacement::place(const std::vector<Instruction *> &Outputs,
+								 const std::vector<Instruction *> &Moved,
+								 const std::vector<Value *> &Inputs,
+								 int overhead) const {
+	// Nearest Common Dominator of the Outputs
+	BasicBlock *NCD = nullptr;
+	for (Instruction *I : Outputs) NCD = NCD == nullptr ? I->getParent() : DT_.findNearestCommonDominator(NCD, I->getParent());
+	if (NCD == nullptr) return nullptr;
+	Instruction *InsertPos = NCD->getTerminator();
+	for (Instruction *I : Outputs)
+		if (I->getParent() == NCD && I->comesBefore(InsertPos)) InsertPos = I;
+
+	// Inputs Dominate the Insertion Point
+	for (Value *V : Inputs)
+		if (isa<Instruction>(V) && !DT_.dominates(cast<Instruction>(V), InsertPos)) return nullptr;
+
+	// Instructions which may Trap are not Hoisted above their Blocks (a block dominating the insertion point runs with it)
+	for (Instruction *I : Moved)
+		if (!DT_.dominates(I->getParent(), NCD) && !isSafeToSpeculativelyExecute(I)) return nullptr;
+
+	// Profitability: the cca runs at the frequency of the insertion point instead of the blocks of the moved instructions
+	double saved = 0.0, cost = (double)overhead * BFI_.getBlockFreq(NCD).getFrequency();
+	for (Instruction *I : Moved) saved += (double)estimateCycles(I) * BFI_.getBlockFreq(I->getParent()).getFrequency();
+	return saved > cost ? InsertPos : nullptr;
+}
+
+} // namespace cca
+} // namespace llvm
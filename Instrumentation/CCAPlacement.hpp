@@ -0,0 +1,41 @@
+#ifndef PIMCCALLVMPASS_INSTRUMENTATION_CCA_PLACEMENT_HPP_
+#define PIMCCALLVMPASS_INSTRUMENTATION_CCA_PLACEMENT_HPP_
+
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instruction.h"
+#include <vector>
+
+namespace llvm {
+namespace cca {
+
+//-------------------------------------
+// Class: CCA Placement
+//-------------------------------------
+// Placement of a match spanning basic blocks: the cca sequence is inserted at the nearest common dominator of the
+// outputs (before the earliest output in that block, or before its terminator), so its results dominate every use
+// of the outputs. The match is rejected when an input does not dominate the insertion point, when an instruction
+// which may trap would be executed on a path where it was not, or when the estimated cycles saved (weighted by block
+// frequency) do not cover the cycles of the cca site (given by the target) at the insertion point.
+class CCAPlacement final {
+  private:
+	DominatorTree &DT_;
+	BlockFrequencyInfo &BFI_;
+
+  public:
+	CCAPlacement(DominatorTree &DT, BlockFrequencyInfo &BFI) : DT_(DT), BFI_(BFI) {}
+	Instruction *place(const std::vector<Instruction *> &Outputs,
+					   const std::vector<Instruction *> &Moved,
+					   const std::vector<Value *> &Inputs,
+					   int overhead) const;
+	// Number the Dominator Tree, so Queries from several Threads only Read it
+	void prepare(void) const { DT_.updateDFSNumbers(); }
+
+	// Rough DPU cycle estimates of the instructions replaced by a cca call
+	static int estimateCycles(const Instruction *I);
+};
+
+} // namespace cca
+} // namespace llvm
+
+#endif // PIMCCALLVMPASS_INSTRUMENTATION_CCA_PLACEMENT_HPP_
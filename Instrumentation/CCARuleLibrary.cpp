@@ -0,0 +1,104 @@
+#include "Instrumentation/CCARuleLibrary.hpp"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace llvm {
+namespace cca {
+
+static cl::opt<std::string> CCARuleFile("cca-rules", cl::desc("Rule library searched by the cca plugin"), cl::value_desc("filename"), cl::init(""));
+
+//-------------------------------------
+// Class: CCA Rule Library
+//-------------------------------------
+CCARuleLibrary::CCARuleLibrary() : Rules_({{"7: o24 = i24 + i25 + i26 + i27 + i28", 0, true}}) {}
+
+// Load the Library Once (on an error, the default rule is used)
+const CCARuleLibrary &CCARuleLibrary::get(void) {
+	static const CCARuleLibrary Library = [] {
+		CCARuleLibrary L;
+		std::string path = CCARuleFile;
+		if (path.empty() && std::getenv("CCA_RULE_LIBRARY") != nullptr) path = std::getenv("CCA_RULE_LIBRARY");
+		if (path.empty()) return L;
+		auto Buffer = MemoryBuffer::getFile(path);
+		std::string Err;
+		if (!Buffer) Err = Buffer.getError().message();
+		else if (L.parse(Buffer.get()->getBuffer(), Err)) {
+			outs() << "[PIM-CCA-PASS] Load " << L.Rules_.size() << " Rules (" << L.rules().size() << " Enabled) from \"" << path << "\"\n";
+			return L;
+		}
+		std::cerr << "[PIM-CCA-PASS][ERROR] cannot load the rule library " << path << ": " << Err << "\n";
+		return CCARuleLibrary();
+	}();
+	return Library;
+}
+
+bool CCARuleLibrary::parse(StringRef Buffer, std::string &Err) {
+	Rules_.clear();
+	SmallVector<StringRef, 64> Lines;
+	Buffer.split(Lines, '\n');
+	for (unsigned idx = 0; idx < Lines.size(); ++idx) {
+		StringRef Line = Lines[idx].split('#').first.trim();
+		if (Line.empty()) continue;
+		std::string where = "line " + std::to_string(idx + 1);
+		Rule R = {"", 0, true};
+		// Attributes
+		if (Line.startswith("[")) {
+			std::pair<StringRef, StringRef> AR = Line.drop_front(1).split(']');
+			if (!Line.contains(']')) {
+				Err = where + ": expected \"]\" after the attributes";
+				return false;
+			}
+			SmallVector<StringRef, 4> Attrs;
+			AR.first.split(Attrs, ',', -1, false);
+			for (StringRef Attr : Attrs) {
+				std::pair<StringRef, StringRef> KV = Attr.split('=');
+				StringRef Key = KV.first.trim(), Value = KV.second.trim();
+				if (Key == "priority") {
+					if (Value.getAsInteger(10, R.priority)) {
+						Err = where + ": expected a priority";
+						return false;
+					}
+				} else if (Key == "enabled" || Key == "disabled") {
+					bool flag = true;
+					if (Attr.contains('=')) {
+						if (Value == "false" || Value == "0") flag = false;
+						else if (Value != "true" && Value != "1") {
+							Err = where + ": expected true or false for \"" + Key.str() + "\"";
+							return false;
+						}
+					}
+					R.enabled = (Key == "enabled") == flag;
+				} else {
+					Err = where + ": unknown attribute \"" + Key.str() + "\"";
+					return false;
+				}
+			}
+			Line = AR.second.trim();
+		}
+		// Rule Number (the rest is parsed by the pass)
+		unsigned rule = 0;
+		if (!Line.contains(':') || Line.split(':').first.trim().getAsInteger(10, rule)) {
+			Err = where + ": expected a rule \"N: ...\"";
+			return false;
+		}
+		R.pattern = Line.str();
+		Rules_.push_back(R);
+	}
+	std::stable_sort(Rules_.begin(), Rules_.end(), [](const Rule &A, const Rule &B) { return A.priority > B.priority; });
+	return true;
+}
+
+std::vector<std::string> CCARuleLibrary::rules(void) const {
+	std::vector<std::string> Patterns;
+	for (const Rule &R : Rules_)
+		if (R.enabled) Patterns.push_back(R.pattern);
+	return Patterns;
+}
+
+} // namespace cca
+} // namespace llvm
@@ -0,0 +1,44 @@
+#ifndef PIMCCALLVMPASS_INSTRUMENTATION_CCA_RULE_LIBRARY_HPP_
+#define PIMCCALLVMPASS_INSTRUMENTATION_CCA_RULE_LIBRARY_HPP_
+
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+namespace cca {
+
+//-------------------------------------
+// Class: CCA Rule Library
+//-------------------------------------
+// Rules of the plugin, loaded once from the file given by -cca-rules (or the CCA_RULE_LIBRARY environment variable):
+//   # comment
+//   7: o24 = i24 + i25 + i26 + i27 + i28                        enabled rule of priority 0
+//   [priority = 2] 8: o24 = i24 + i28; o25 = i25 + o24          searched before the rules of lower priorities
+//   [disabled] 9: t24 = i24 > i25 ? i24 : i25; o24 = t24 ...    kept in the file, but not searched
+// Attributes are separated by commas, and the flags enabled and disabled may be given a value (true, false, 1 or 0).
+// Rules are searched by decreasing priority, and in file order at the same priority.
+// Without a file, the plugin searches the default rule 7.
+class CCARuleLibrary final {
+  private:
+	struct Rule {
+		std::string pattern;
+		int priority;
+		bool enabled;
+	};
+	std::vector<Rule> Rules_;
+
+	CCARuleLibrary();
+	bool parse(StringRef Buffer, std::string &Err);
+
+  public:
+	static const CCARuleLibrary &get(void);
+
+	// Enabled Rules in Search Order
+	std::vector<std::string> rules(void) const;
+};
+
+} // namespace cca
+} // namespace llvm
+
+#endif // PIMCCALLVMPASS_INSTRUMENTATION_CCA_RULE_LIBRARY_HPP_
@@ -0,0 +1,126 @@
+#include "Instrumentation/CCATarget.hpp"
+#include "Instrumentation/CCAPatternGraph.hpp"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace llvm {
+namespace cca {
+
+static cl::opt<std::string> CCATargetFile("cca-target",
+										  cl::desc("Target description of the cca unit (registers, input and output limits, cycles)"),
+										  cl::value_desc("filename"),
+										  cl::init(""));
+
+//-------------------------------------
+// Class: CCA Target
+//-------------------------------------
+CCATarget::CCATarget()
+	: firstReg_(24), numRegs_(8), maxInputs_(8), maxOutputs_(8), moveInCycles_(1), moveOutCycles_(1), latency_(1), RuleLatency_() {}
+
+// Load the Description Once (on an error, the default unit is used)
+const CCATarget &CCATarget::get(void) {
+	static const CCATarget Target = [] {
+		CCATarget T;
+		std::string path = CCATargetFile;
+		if (path.empty() && std::getenv("CCA_TARGET") != nullptr) path = std::getenv("CCA_TARGET");
+		if (path.empty()) return T;
+		auto Buffer = MemoryBuffer::getFile(path);
+		std::string Err;
+		if (!Buffer) Err = Buffer.getError().message();
+		else if (T.parse(Buffer.get()->getBuffer(), Err)) {
+			outs() << "[PIM-CCA-PASS] Load Target Description from \"" << path << "\"\n";
+			return T;
+		}
+		std::cerr << "[PIM-CCA-PASS][ERROR] cannot load the target description " << path << ": " << Err << "\n";
+		return CCATarget();
+	}();
+	return Target;
+}
+
+bool CCATarget::parse(StringRef Buffer, std::string &Err) {
+	SmallVector<StringRef, 16> Lines;
+	Buffer.split(Lines, '\n');
+	for (unsigned idx = 0; idx < Lines.size(); ++idx) {
+		StringRef Line = Lines[idx].split('#').first.trim();
+		if (Line.empty()) continue;
+		std::pair<StringRef, StringRef> KV = Line.split('=');
+		StringRef Key = KV.first.trim(), Value = KV.second.trim();
+		std::string where = "line " + std::to_string(idx + 1);
+		unsigned rule = 0;
+		int cycles = 0;
+		if (Key == "registers") {
+			std::pair<StringRef, StringRef> FN = Value.split(' ');
+			if (FN.first.trim().getAsInteger(10, firstReg_) || FN.second.trim().getAsInteger(10, numRegs_) || numRegs_ == 0) {
+				Err = where + ": expected the first register and the number of registers";
+				return false;
+			}
+		} else if (Key == "max-inputs" || Key == "max-outputs") {
+			if (Value.getAsInteger(10, Key == "max-inputs" ? maxInputs_ : maxOutputs_)) {
+				Err = where + ": expected a number of registers";
+				return false;
+			}
+		} else if (Key == "move-in" || Key == "move-out" || Key == "latency") {
+			if (Value.getAsInteger(10, Key == "move-in" ? moveInCycles_ : Key == "move-out" ? moveOutCycles_ : latency_)) {
+				Err = where + ": expected a number of cycles";
+				return false;
+			}
+		} else if (Key.startswith("latency.") && !Key.drop_front(8).getAsInteger(10, rule)) {
+			if (Value.getAsInteger(10, cycles)) {
+				Err = where + ": expected a number of cycles";
+				return false;
+			}
+			RuleLatency_[rule] = cycles;
+		} else {
+			Err = where + ": unknown key \"" + Key.str() + "\"";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool CCATarget::isBlock(const std::vector<unsigned> &Regs) const {
+	for (unsigned i = 0; i < Regs.size(); ++i)
+		if (Regs[i] != firstReg_ + i) return false;
+	return true;
+}
+
+int CCATarget::latency(unsigned rule) const {
+	auto Iter = RuleLatency_.find(rule);
+	return Iter == RuleLatency_.end() ? latency_ : Iter->second;
+}
+
+// Input and Output Registers of a Rule, in Order (temporaries stay in the unit)
+static void getRegisters(const CCAPatternGraph &G, char regtype, std::vector<unsigned> &Regs) {
+	for (const auto &Reg : G.program().regs())
+		if (Reg.first == regtype) Regs.push_back(Reg.second);
+	std::sort(Regs.begin(), Regs.end());
+}
+
+bool CCATarget::check(const CCAPatternGraph &G, std::string &Err) const {
+	std::vector<unsigned> Inputs, Outputs;
+	getRegisters(G, 'i', Inputs);
+	getRegisters(G, 'o', Outputs);
+	for (unsigned reg : Inputs)
+		if (!isRegister(reg)) Err = "input register i" + std::to_string(reg) + " is not in the cca register file";
+	for (unsigned reg : Outputs)
+		if (!isRegister(reg)) Err = "output register o" + std::to_string(reg) + " is not in the cca register file";
+	if (Inputs.size() > maxInputs_) Err = std::to_string(Inputs.size()) + " inputs exceed the maximum of " + std::to_string(maxInputs_);
+	if (Outputs.size() > maxOutputs_) Err = std::to_string(Outputs.size()) + " outputs exceed the maximum of " + std::to_string(maxOutputs_);
+	return Err.empty();
+}
+
+int CCATarget::overhead(const CCAPatternGraph &G) const {
+	std::vector<unsigned> Inputs, Outputs;
+	getRegisters(G, 'i', Inputs);
+	getRegisters(G, 'o', Outputs);
+	int moveIns = isBlock(Inputs) ? 1 : Inputs.size(), moveOuts = isBlock(Outputs) ? 1 : Outputs.size();
+	return moveIns * moveInCycles_ + latency(G.rule_number()) + moveOuts * moveOutCycles_;
+}
+
+} // namespace cca
+} // namespace llvm
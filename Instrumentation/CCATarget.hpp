@@ -0,0 +1,62 @@
+#ifndef PIMCCALLVMPASS_INSTRUMENTATION_CCA_TARGET_HPP_
+#define PIMCCALLVMPASS_INSTRUMENTATION_CCA_TARGET_HPP_
+
+#include "llvm/ADT/StringRef.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace llvm {
+namespace cca {
+
+class CCAPatternGraph;
+
+//-------------------------------------
+// Class: CCA Target
+//-------------------------------------
+// Description of the cca unit, loaded once from the file given by -cca-target (or the CCA_TARGET environment variable):
+//   # comment
+//   registers = 24 8     first register and number of registers of the cca register file
+//   max-inputs = 5       maximum number of inputs of a rule
+//   max-outputs = 4      maximum number of outputs of a rule
+//   move-in = 1          cycles of a move of the inputs
+//   move-out = 1         cycles of a move of the outputs
+//   latency = 1          cycles of a cca
+//   latency.7 = 3        cycles of the cca of rule 7
+// Registers from the first one are moved by one cca_move, and the others by a move each.
+// Without a file, the register file is r24 to r31 and every move and cca takes one cycle.
+class CCATarget final {
+  private:
+	unsigned firstReg_;
+	unsigned numRegs_;
+	unsigned maxInputs_;
+	unsigned maxOutputs_;
+	int moveInCycles_;
+	int moveOutCycles_;
+	int latency_;
+	std::map<unsigned, int> RuleLatency_;
+
+	CCATarget();
+	bool parse(StringRef Buffer, std::string &Err);
+
+  public:
+	static const CCATarget &get(void);
+
+	unsigned firstRegister(void) const { return firstReg_; }
+	bool isRegister(unsigned reg) const { return reg >= firstReg_ && reg < firstReg_ + numRegs_; }
+	// Registers moved by one cca_move (the first registers of the file, in order)
+	bool isBlock(const std::vector<unsigned> &Regs) const;
+	unsigned maxInputs(void) const { return maxInputs_; }
+	unsigned maxOutputs(void) const { return maxOutputs_; }
+	int latency(unsigned rule) const;
+
+	// Check the Registers of a Rule Fit the Unit
+	bool check(const CCAPatternGraph &G, std::string &Err) const;
+	// Cycles of a CCA Site of a Rule: moving the inputs, running the cca and moving the outputs
+	int overhead(const CCAPatternGraph &G) const;
+};
+
+} // namespace cca
+} // namespace llvm
+
+#endif // PIMCCALLVMPASS_INSTRUMENTATION_CCA_TARGET_HPP_
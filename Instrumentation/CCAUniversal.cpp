@@ -1,12 +1,26 @@
 #include "Instrumentation/CCAUniversal.hpp"
+#include "Instrumentation/CCACandidateIndex.hpp"
+#include "Instrumentation/CCAEGraph.hpp"
+#include "Instrumentation/CCAIntrinsics.hpp"
 #include "Instrumentation/CCAPatternGraph.hpp"
+#include "Instrumentation/CCATarget.hpp"
 #include "Instrumentation/parser/parser.hpp"
-#include "llvm/IR/InlineAsm.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_os_ostream.h"
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <ostream>
 #include <set>
 #include <sstream>
@@ -18,6 +32,43 @@ using namespace llvm;
 namespace llvm {
 namespace cca {
 
+enum class CCASelection { Greedy, Optimal };
+static cl::opt<CCASelection> CCASelectionMode("cca-selection",
+											  cl::desc("How the cca pass chooses among overlapping matches in a basic block"),
+											  cl::init(CCASelection::Greedy),
+											  cl::values(clEnumValN(CCASelection::Greedy, "greedy", "commit matches in search order (the first binding of each candidate)"),
+														 clEnumValN(CCASelection::Optimal,
+																	"optimal",
+																	"collect all matches and choose a maximum-weight non-overlapping set")));
+static cl::opt<bool> CCAEGraphMode("cca-egraph",
+								   cl::desc("Match the rules on an e-graph of each basic block, to find matches hidden by rewrites (with the greedy "
+											"selection, the first binding of a candidate is taken, not the cover saving the most: use "
+											"-cca-selection=optimal for it)"),
+								   cl::init(false));
+static cl::opt<unsigned> CCAEGraphNodes("cca-egraph-nodes", cl::desc("Maximum number of e-graph nodes added by rewrites in a basic block"), cl::init(1024));
+static cl::opt<unsigned> CCAEGraphIterations("cca-egraph-iterations", cl::desc("Maximum number of e-graph rewrite iterations"), cl::init(4));
+static cl::opt<bool> CCACrossBlock("cca-cross-block",
+								   cl::desc("Match patterns spanning basic blocks, placing the cca at the nearest common dominator of the outputs"),
+								   cl::init(false));
+static cl::opt<bool> CCAHotFirst("cca-hot-first",
+								 cl::desc("Search the hottest blocks first, by block frequency with a profile or by loop depth without one"),
+								 cl::init(false));
+static cl::opt<unsigned> CCACandidateBudget("cca-candidate-budget", cl::desc("Maximum number of candidates tried in a function (0 is unlimited)"), cl::init(0));
+static cl::opt<unsigned> CCATimeBudget("cca-time-budget-ms", cl::desc("Maximum search time in a function in milliseconds (0 is unlimited)"), cl::init(0));
+static cl::opt<unsigned> CCAThreads("cca-threads", cl::desc("Number of threads searching the functions of a module in the cca-universal pass (0 is all the cores)"), cl::init(1));
+static cl::opt<unsigned> CCABlockThreads("cca-block-threads",
+										 cl::desc("Number of threads searching the candidates of a large basic block, with the greedy selection "
+												  "and without e-graphs (0 is all the cores)"),
+										 cl::init(1));
+static cl::opt<bool> CCACheckBlockThreads("cca-check-block-threads",
+										   cl::desc("Search each block searched by several threads again sequentially, and report the matches "
+													"which differ"),
+										   cl::init(false));
+static cl::opt<unsigned> CCABlockSize("cca-block-size", cl::desc("Minimum number of instructions of a basic block searched by several threads"), cl::init(2048));
+static cl::opt<bool> CCAMemorySSA("cca-memoryssa",
+								  cl::desc("Remove stores of intermediate values killed by later stores, by MemorySSA and alias analysis"),
+								  cl::init(true));
+
 // Print Pattern Instance
 void CCAPattern::print(unsigned indent, std::ostream &os) const {
 	// candidate
@@ -38,117 +89,35 @@ void CCAPattern::print(unsigned indent, std::ostream &os) const {
 }
 
 // Build (Find) CCA Pattern in the Codes with a Pattern Graph Instance
-CCAPattern *CCAPattern::get(CCAPatternGraph *Graph,
+CCAPattern *CCAPattern::get(const CCAPatternGraph *Graph,
 							const std::vector<Instruction *> &Candidate,
 							std::set<Instruction *> &Removed,
-							const std::set<Instruction *> &UnRemovable) {
+							const std::set<Instruction *> &UnRemovable,
+							CCAMatchState &S,
+							bool next) {
 
 	unsigned length = Candidate.size();
-	auto reginfo = Graph->output_reginfo();
-	if (length != reginfo.size()) return nullptr;
+	if (length != Graph->root_size()) return nullptr;
+	if (!Graph->matchWithCode(Candidate, UnRemovable, Removed, S, next)) return nullptr;
 
+	// Only Matched Patterns are Allocated
 	CCAPattern *P = new CCAPattern(Candidate);
-	for (unsigned idx = 0; idx < length; ++idx) P->OutputRegValueMap_.insert({reginfo.at(idx).second, Candidate.at(idx)});
-	if (!Graph->matchWithCode(Candidate, UnRemovable, Removed, P->InputRegValueMap_, P->OutputRegValueMap_)) {
-		delete P;
-		P = nullptr;
-	}
+	S.getRegValueMap('i', P->InputRegValueMap_);
+	S.getRegValueMap('o', P->OutputRegValueMap_);
+	P->InsertPos_ = S.insertPoint();
+	P->Hoisted_ = S.hoisted();
 	return P;
 }
 
 // Build CCA Instruction from Matched Patterns
+// The cca sequence is built from the pseudo-intrinsics, which are lowered to inline assembly by CCALowerIntrinsicsPass
 void CCAPattern::build(unsigned int ccaid, LLVMContext &Context) {
-	Type *VoidTy = Type::getVoidTy(Context);
 	Type *Int32Ty = Type::getInt32Ty(Context);
 
-	// Prepare CCA Inline Assembly
-	unsigned CCAInputMoveLength = InputRegValueMap_.size();
-	FunctionType *CCAInputMoveInstFT = FunctionType::get(VoidTy, std::vector<Type *>(CCAInputMoveLength, Int32Ty), false);
-	std::string CCAInputMoveAsmStr = "#removethiscomment cca_move $0";
-	std::string CCAInputMoveConstraints = "r";
-	for (unsigned i = 1; i < CCAInputMoveLength; ++i) {
-		CCAInputMoveAsmStr += (", $" + std::to_string(i));
-		CCAInputMoveConstraints += ",r";
-	}
-	InlineAsm *CCAInputMoveIA = InlineAsm::get(CCAInputMoveInstFT, CCAInputMoveAsmStr, CCAInputMoveConstraints, true);
-
-	FunctionType *CCAInstFT = FunctionType::get(VoidTy, false);
-	InlineAsm *CCAInstIA = InlineAsm::get(CCAInstFT, "#removethiscomment cca " + std::to_string(ccaid), "", true);
-
-#if 0
-	unsigned CCAOutputMoveLength = OutputRegValueMap_.size();
-	FunctionType *CCAOutputMoveInstFT = FunctionType::get(
-		CCAOutputMoveLength == 1 ? Int32Ty : StructType::get(Context, std::vector<Type *>(CCAOutputMoveLength, Int32Ty)), VoidTy, false);
-	std::string CCAOutputMoveAsmStr = "#removethiscomment cca_moveout $0";
-	std::string CCAOutputMoveConstraints = "=r";
-	for (unsigned i = 1; i < CCAOutputMoveLength; ++i) {
-		CCAOutputMoveAsmStr += (", $" + std::to_string(i));
-		CCAOutputMoveConstraints += ",=r";
-	}
-	InlineAsm *CCAOutputMoveIA = InlineAsm::get(CCAOutputMoveInstFT, CCAOutputMoveAsmStr, CCAOutputMoveConstraints, true);
-#elif 0
-	FunctionType *CCAOutputMoveInstFT = FunctionType::get(Int32Ty, VoidTy, false);
-	std::string CCAOutputMoveAsmStr = "#removethiscomment move $0 r" + std::to_string(OutputRegValueMap_.begin()->first);
-	std::string CCAOutputMoveConstraints = "=r";
-	InlineAsm *CCAOutputMoveIA = InlineAsm::get(CCAOutputMoveInstFT, CCAOutputMoveAsmStr, CCAOutputMoveConstraints, true);
-#else
-	unsigned CCAOutputMoveLength = OutputRegValueMap_.size();
-	FunctionType *CCAOutputMoveInstFT = nullptr;
-	InlineAsm *CCAOutputMoveIA = nullptr;
-	if (CCAOutputMoveLength == 1) {
-		CCAOutputMoveInstFT = FunctionType::get(Int32Ty, VoidTy, false);
-		std::string CCAOutputMoveAsmStr = "#removethiscomment move $0, r" + std::to_string(OutputRegValueMap_.begin()->first);
-		std::string CCAOutputMoveConstraints = "=r";
-		CCAOutputMoveIA = InlineAsm::get(CCAOutputMoveInstFT, CCAOutputMoveAsmStr, CCAOutputMoveConstraints, true);
-	} else if (CCAOutputMoveLength == 4) {
-		CCAOutputMoveInstFT = FunctionType::get(StructType::get(Context, std::vector<Type *>(CCAOutputMoveLength, Int32Ty)), VoidTy, false);
-		CCAOutputMoveIA = InlineAsm::get(CCAOutputMoveInstFT, "#removethiscomment cca_move $0, $1, $2, $3", "=r,=r,=r,=r", true);
-	} else {
-		std::cerr << "[PIM-CCA-PASS][ERROR] cca pass only surrport #output_register = 1 or 4 in current version\n";
-		return;
-	}
-#endif
-
-	// Build Instructions
-	// Move Input Value to Register
-	std::vector<Value *> CCAInputMoveOperands;
-	for (unsigned i = 0; i < CCAInputMoveLength; ++i) CCAInputMoveOperands.push_back(InputRegValueMap_.at(24 + i));
-	CallInst *CCAInputMoveInst = CallInst::Create(FunctionCallee(CCAInputMoveInstFT, CCAInputMoveIA), CCAInputMoveOperands);
-	CCAInputMoveInst->setTailCall(true);
-	// Run CCA
-	CallInst *CCACallInst = CallInst::Create(FunctionCallee(CCAInstFT, CCAInstIA));
-	CCACallInst->setTailCall(true);
-	// Move Output Value to Register
-	std::vector<Instruction *> CCAOutputMoveInstVec;
-	CallInst *CCAOutputMoveInst = CallInst::Create(FunctionCallee(CCAOutputMoveInstFT, CCAOutputMoveIA), "ccamoveout");
-	CCAOutputMoveInst->setTailCall(false);
-	CCAOutputMoveInstVec.push_back(CCAOutputMoveInst);
-#if 0
-	if (CCAOutputMoveLength == 1) CCAOutputInst_.push_back(CCAOutputMoveInst);
-	else {
-		for (unsigned i = 0; i < CCAOutputMoveLength; ++i) {
-			Instruction *I = ExtractValueInst::Create(CCAOutputMoveInst, {i}, "extractccaout");
-			CCAOutputMoveInstVec.push_back(I);
-			CCAOutputInst_.push_back(I);
-		}
-	}
-#elif 0
-	CCAOutputInst_.push_back(CCAOutputMoveInst);
-#else
-	if (CCAOutputMoveLength == 1) CCAOutputInst_.push_back(CCAOutputMoveInst);
-	else {
-		for (unsigned i = 0; i < CCAOutputMoveLength; ++i) {
-			Instruction *I = ExtractValueInst::Create(CCAOutputMoveInst, {i}, "extractccaout");
-			CCAOutputMoveInstVec.push_back(I);
-			CCAOutputInst_.push_back(I);
-		}
-	}
-#endif
-
-	// Insert Instructions & Replace All Uses
+	// Find the Insertion Point
 	Instruction *InsertPosFromUse = nullptr, *InsertPos = nullptr;
 	for (auto mapIter : OutputRegValueMap_) {
-		if (!isa<Instruction>(mapIter.second)) continue;
+		if (InsertPos_ != nullptr || !isa<Instruction>(mapIter.second)) continue;
 		Instruction *I = cast<Instruction>(mapIter.second);
 		if (InsertPosFromUse == nullptr) InsertPosFromUse = I;
 		else if (I->comesBefore(InsertPosFromUse))
@@ -163,11 +132,23 @@ void CCAPattern::build(unsigned int ccaid, LLVMContext &Context) {
 	}
 	if(!InsertPosFromOperand->comesBefore(InsertPosFromUse)) ;
 	*/
-	InsertPos = InsertPosFromUse;
+	InsertPos = InsertPos_ != nullptr ? InsertPos_ : InsertPosFromUse;
+	Module &M = *InsertPos->getModule();
 
-	CCAInputMoveInst->insertBefore(InsertPos);
-	CCACallInst->insertBefore(InsertPos);
-	for (auto *I : CCAOutputMoveInstVec) I->insertBefore(InsertPos);
+	// Build Instructions
+	// Move Input Value to Register (the registers, then the values)
+	std::vector<Value *> CCAInputMoveOperands;
+	for (auto mapIter : InputRegValueMap_) CCAInputMoveOperands.push_back(ConstantInt::get(Int32Ty, mapIter.first));
+	for (auto mapIter : InputRegValueMap_) CCAInputMoveOperands.push_back(mapIter.second);
+	CallInst *CCAInputMoveInst = CallInst::Create(getCCAMoveIn(M, InputRegValueMap_.size()), CCAInputMoveOperands, "", InsertPos);
+	CCAInputMoveInst->setTailCall(true);
+	// Run CCA
+	CallInst *CCACallInst = CallInst::Create(getCCAExec(M), {ConstantInt::get(Int32Ty, ccaid)}, "", InsertPos);
+	CCACallInst->setTailCall(true);
+	// Move Output Value to Register (the outputs are extracted by resolve)
+	std::vector<Value *> CCAOutputRegs;
+	for (auto mapIter : OutputRegValueMap_) CCAOutputRegs.push_back(ConstantInt::get(Int32Ty, mapIter.first));
+	CCAOutputMoveInst_ = CallInst::Create(getCCAMoveOut(M, CCAOutputRegs.size()), CCAOutputRegs, "ccamoveout", InsertPos);
 
 	/*
 	for (auto mapIter : InputRegValueMap_) {
@@ -178,112 +159,577 @@ void CCAPattern::build(unsigned int ccaid, LLVMContext &Context) {
 	*/
 }
 
+// Replace the Outputs by the Moved Values, in Register Order (an output without users is not extracted)
 void CCAPattern::resolve(void) {
-	for (unsigned i = 0; i < CCAOutputInst_.size(); ++i) OutputRegValueMap_.at(24 + i)->replaceAllUsesWith(CCAOutputInst_.at(i));
+	if (CCAOutputMoveInst_ == nullptr) return;
+	if (OutputRegValueMap_.size() == 1) {
+		OutputRegValueMap_.begin()->second->replaceAllUsesWith(CCAOutputMoveInst_);
+		return;
+	}
+	Instruction *InsertPos = CCAOutputMoveInst_;
+	unsigned idx = 0;
+	for (auto mapIter : OutputRegValueMap_) {
+		if (!mapIter.second->use_empty()) {
+			Instruction *I = ExtractValueInst::Create(CCAOutputMoveInst_, {idx}, "extractccaout");
+			I->insertAfter(InsertPos);
+			InsertPos = I;
+			mapIter.second->replaceAllUsesWith(I);
+			CCAOutputInst_.push_back(I);
+		}
+		++idx;
+	}
+}
+
+// Erase the Extracted Outputs Used Only by Erased Instructions (such as the other outputs of a chain)
+void CCAPattern::prune(void) {
+	for (Instruction *I : CCAOutputInst_)
+		if (I->use_empty()) I->eraseFromParent();
+	CCAOutputInst_.clear();
 }
 
 //--------------------------------------------
 // Candidate Iterator for Universal Pass
 //--------------------------------------------
 
-class CandidateInstIter {
+// Candidates are generated root by root: the first root is seeded with the instructions classified for it,
+// and each later root is derived from an earlier root by walking the use-def path to a shared register.
+// Roots without a shared register fall back to the instructions classified for them in the block.
+// Across blocks, a derived root may be in another block than its anchor, but not in another function.
+class CandidateIter {
   private:
-	const unsigned op_;
-	BasicBlock::iterator begin_, cur_, end_;
+	const std::vector<unsigned> opcode_;
+	const std::vector<CCAPatternRootLink> links_;
+	const CCARootCandidates &roots_;
+	const CCAEGraph *EG_; // on an e-graph, a root matches the opcode if its class has a node of it
+	const bool crossblock_;
+	std::vector<std::vector<Instruction *>> choices_;
+	std::vector<unsigned> pos_;
+	bool terminated_;
+	// Scratch buffers reused across candidates
+	std::vector<Instruction *> current_;
+	std::vector<Value *> shared_, frontier_, next_;
+
+	// Derive the Candidates of a Root from the Current Choice of its Anchor
+	bool derive(unsigned idx) {
+		const CCAPatternRootLink &L = links_.at(idx);
+		std::vector<Instruction *> &C = choices_.at(idx);
+		C.clear();
+		if (!L.linked) {
+			C = roots_.at(idx);
+			return !C.empty();
+		}
+		Instruction *Anchor = choices_.at(L.anchor).at(pos_.at(L.anchor));
+		BasicBlock *BB = Anchor->getParent();
+		Function *F = Anchor->getFunction();
+		// Walk down to the values which may be bound to the shared register;
+		// constants and globals are skipped, as their users are spread over the whole module
+		shared_.clear();
+		frontier_.assign(1, Anchor);
+		for (unsigned depth = 0; depth <= *L.down.rbegin() && !frontier_.empty(); ++depth) {
+			next_.clear();
+			for (Value *V : frontier_) {
+				if (L.down.count(depth) && !isa<Constant>(V) && std::find(shared_.begin(), shared_.end(), V) == shared_.end()) shared_.push_back(V);
+				if (!isa<Instruction>(V) || depth == *L.down.rbegin()) continue;
+				for (Value *OP : cast<Instruction>(V)->operands()) next_.push_back(OP);
+			}
+			frontier_.swap(next_);
+		}
+		// Walk up to the roots which may use the shared register
+		frontier_.assign(shared_.begin(), shared_.end());
+		for (unsigned depth = 0; depth <= *L.up.rbegin() && !frontier_.empty(); ++depth) {
+			next_.clear();
+			for (Value *V : frontier_) {
+				if (L.up.count(depth) && isa<Instruction>(V)) {
+					Instruction *I = cast<Instruction>(V);
+					bool opcode = EG_ != nullptr ? EG_->hasNode(I, opcode_.at(idx)) : I->getOpcode() == opcode_.at(idx);
+					if ((crossblock_ ? I->getFunction() == F : I->getParent() == BB) && opcode && std::find(C.begin(), C.end(), I) == C.end()) C.push_back(I);
+				}
+				if (depth == *L.up.rbegin()) continue;
+				for (User *U : V->users())
+					if (isa<Instruction>(U) && (crossblock_ ? cast<Instruction>(U)->getFunction() == F : cast<Instruction>(U)->getParent() == BB)) next_.push_back(U);
+			}
+			frontier_.swap(next_);
+		}
+		return !C.empty();
+	}
+
+	// Advance the Root at idx and Re-derive the Roots after it
+	void step(unsigned idx) {
+		while (true) {
+			if (++pos_.at(idx) >= choices_.at(idx).size()) {
+				if (idx == 0) {
+					terminated_ = true;
+					return;
+				}
+				--idx;
+				continue;
+			}
+			unsigned next = idx + 1;
+			while (next < pos_.size() && derive(next)) pos_.at(next++) = 0;
+			if (next == pos_.size()) return;
+			idx = next - 1;
+		}
+	}
 
   public:
-	CandidateInstIter(unsigned op, BasicBlock::iterator begin, BasicBlock::iterator end) : op_(op), begin_(begin), cur_(begin), end_(end) {
-		if (cur_->getOpcode() != op_) increase();
+	CandidateIter(const std::vector<unsigned> &opcode,
+				  const std::vector<CCAPatternRootLink> &links,
+				  const CCARootCandidates &Roots,
+				  const CCAEGraph *EG = nullptr,
+				  bool crossblock = false)
+		: opcode_(opcode), links_(links), roots_(Roots), EG_(EG), crossblock_(crossblock), choices_(opcode.size()), pos_(opcode.size(), 0), terminated_(false),
+		  current_(), shared_(), frontier_(), next_() {
+		choices_.at(0) = roots_.at(0);
+		if (choices_.at(0).empty()) terminated_ = true;
+		else {
+			unsigned next = 1;
+			while (next < pos_.size() && derive(next)) ++next;
+			if (next < pos_.size()) step(next - 1);
+		}
+		while (valid() && duplicated()) increase();
 	}
 
 	void increase(void) {
-		while (cur_ != end_) {
-			cur_++;
-			if (cur_->getOpcode() == op_) break;
+		if (!terminated_) step(pos_.size() - 1);
+	}
+
+	bool valid(void) const { return !terminated_; }
+
+	bool duplicated(void) const {
+		for (unsigned i = 0; i < pos_.size(); ++i) {
+			for (unsigned j = i + 1; j < pos_.size(); ++j) {
+				if (choices_.at(i).at(pos_.at(i)) == choices_.at(j).at(pos_.at(j))) return true;
+			}
 		}
+		return false;
 	}
 
-	void reset(void) { cur_ = begin_; }
-	bool valid(void) const { return cur_ != end_; }
-	unsigned size(void) const {
-		unsigned numInst = 0;
-		for (auto it = begin_; it != end_; ++it)
-			if (cur_->getOpcode() == op_) numInst++;
-		return numInst;
+	bool isInSet(const std::set<Instruction *> &Set) const {
+		for (unsigned idx = 0; idx < pos_.size(); ++idx)
+			if (Set.find(choices_.at(idx).at(pos_.at(idx))) != Set.end()) return true;
+		return false;
 	}
-	BasicBlock::iterator get(void) const { return cur_; }
 
-	bool operator==(const CandidateInstIter &Iter) const {
-		if (this->cur_ == Iter.cur_) return true;
-		else
-			return false;
+	const std::vector<Instruction *> &get(void) {
+		current_.clear();
+		for (unsigned idx = 0; idx < pos_.size(); ++idx) current_.push_back(choices_.at(idx).at(pos_.at(idx)));
+		return current_;
 	}
 };
 
-class CandidateIter {
+//--------------------------------------------
+// Greedy Search of a Block
+//--------------------------------------------
+// Commit the First Match Found for each Candidate (without a budget, every candidate is tried)
+static void searchGreedy(const CCAPatternGraph *G,
+						 CandidateIter &CIter,
+						 CCAMatchState &S,
+						 CCASearchBudget *Budget,
+						 std::vector<CCAPattern *> &PatternVec,
+						 std::set<Instruction *> &RemovedInsts,
+						 std::set<Instruction *> &ReplacedInsts,
+						 std::set<Instruction *> &HoistedInsts) {
+	while (CIter.valid() && (Budget == nullptr || Budget->spend())) {
+		// Get Patterns using Candidates
+		const std::vector<Instruction *> &Candidate = CIter.get();
+		CCAPattern *P = CCAPattern::get(G, Candidate, RemovedInsts, ReplacedInsts, S);
+		if (P != nullptr) {
+			PatternVec.push_back(P);
+			ReplacedInsts.insert(Candidate.begin(), Candidate.end());
+			for (auto mapIter : P->ORVM()) ReplacedInsts.insert(cast<Instruction>(mapIter.second));
+			HoistedInsts.insert(P->hoisted().begin(), P->hoisted().end());
+		}
+		// Update Iterators
+		CIter.increase();
+		while (CIter.valid() && (CIter.duplicated() || CIter.isInSet(RemovedInsts) || CIter.isInSet(ReplacedInsts))) CIter.increase();
+	}
+}
+
+//--------------------------------------------
+// Parallel Greedy Search of a Large Block
+//--------------------------------------------
+// The candidates of a block are enumerated in windows. The candidates of a window are matched by the workers without
+// the instructions removed or replaced by earlier matches, and the tentative matches are then committed in candidate
+// order as the sequential search would: a match is kept if it touches none of those instructions (the sets only make
+// matching fail, so the sequential search finds the same binding), and is searched again with them otherwise.
+static const unsigned CCAChunkSize = 32;
+static const unsigned CCAWindowChunks = 16; // per worker
+
+struct CCATentativeMatch {
+	CCAPattern *P;
+	std::vector<Instruction *> Removed;
+	std::vector<Instruction *> Touched; // roots, bound values and removed instructions (sorted)
+};
+
+// Chunks of a Window: each worker takes the chunks of its own range from the front, and steals from the back of
+// another range when its own is empty
+class CCAChunkQueues final {
   private:
-	bool terminated_;
-	std::vector<CandidateInstIter> I_;
+	struct Range {
+		std::mutex M;
+		unsigned front, back;
+	};
+	std::vector<Range> Ranges_;
+	const unsigned size_;
 
   public:
-	CandidateIter(const std::vector<unsigned> &opcode, BasicBlock::iterator begin, BasicBlock::iterator end) : terminated_(false) {
-		for (const auto &op : opcode) { I_.push_back(CandidateInstIter(op, begin, end)); }
-		while (valid() && duplicated()) increase();
+	CCAChunkQueues(unsigned workers, unsigned size) : Ranges_(workers), size_(size) {
+		unsigned chunks = (size + CCAChunkSize - 1) / CCAChunkSize;
+		for (unsigned w = 0; w < workers; ++w) {
+			Ranges_[w].front = chunks * w / workers;
+			Ranges_[w].back = chunks * (w + 1) / workers;
+		}
 	}
 
-	void increase(void) {
-		bool t = true;
-		for (auto &Iter : I_) {
-			Iter.increase();
-			if (Iter.valid()) {
-				t = false;
-				break;
+	// Take the Candidates [begin, end) of a Chunk for a Worker (false when every chunk is taken)
+	bool take(unsigned w, unsigned &begin, unsigned &end) {
+		for (unsigned n = 0; n < Ranges_.size(); ++n) {
+			unsigned victim = (w + n) % Ranges_.size();
+			Range &R = Ranges_[victim];
+			std::lock_guard<std::mutex> Lock(R.M);
+			if (R.front == R.back) continue;
+			unsigned chunk = victim == w ? R.front++ : --R.back;
+			begin = chunk * CCAChunkSize;
+			end = std::min(begin + CCAChunkSize, size_);
+			return true;
+		}
+		return false;
+	}
+};
+
+// Search a Block with the Workers, as the Greedy Loop of CCAUniversalPass::search
+static void searchParallel(const CCAPatternGraph *G,
+						   CandidateIter &CIter,
+						   CCAMatchState &S,
+						   std::vector<std::unique_ptr<CCAMatchState>> &Workers,
+						   ThreadPool &Pool,
+						   CCAFunctionSearch &FS) {
+	std::vector<std::vector<Instruction *>> Window;
+	std::vector<CCATentativeMatch> Tentative;
+	bool first = true;
+	while (CIter.valid()) {
+		// Enumerate a Window (duplicated candidates are skipped whatever was matched)
+		Window.clear();
+		while (CIter.valid() && Window.size() < Workers.size() * CCAWindowChunks * CCAChunkSize) {
+			Window.push_back(CIter.get());
+			CIter.increase();
+			while (CIter.valid() && CIter.duplicated()) CIter.increase();
+		}
+
+		// Match the Candidates of the Window
+		Tentative.assign(Window.size(), {nullptr, {}, {}});
+		CCAChunkQueues Queues(Workers.size(), Window.size());
+		for (unsigned w = 0; w < Workers.size(); ++w) {
+			Pool.async([&, w]() {
+				CCAMatchState &WS = *Workers[w];
+				const std::set<Instruction *> NoReplaced;
+				std::set<Instruction *> Removed;
+				std::map<unsigned int, Value *> Bound;
+				unsigned begin = 0, end = 0;
+				while (Queues.take(w, begin, end)) {
+					for (unsigned idx = begin; idx < end; ++idx) {
+						CCATentativeMatch &T = Tentative[idx];
+						Removed.clear();
+						T.P = CCAPattern::get(G, Window[idx], Removed, NoReplaced, WS);
+						if (T.P == nullptr) continue;
+						T.Removed.assign(Removed.begin(), Removed.end());
+						T.Touched = T.Removed;
+						T.Touched.insert(T.Touched.end(), Window[idx].begin(), Window[idx].end());
+						Bound.clear();
+						for (char regtype : {'i', 'o', 't'}) WS.getRegValueMap(regtype, Bound);
+						for (auto mapIter : Bound)
+							if (isa<Instruction>(mapIter.second)) T.Touched.push_back(cast<Instruction>(mapIter.second));
+						T.Touched.insert(T.Touched.end(), T.P->hoisted().begin(), T.P->hoisted().end());
+						std::sort(T.Touched.begin(), T.Touched.end());
+						T.Touched.erase(std::unique(T.Touched.begin(), T.Touched.end()), T.Touched.end());
+					}
+				}
+			});
+		}
+		Pool.wait();
+
+		// Commit in Candidate Order
+		unsigned idx = 0;
+		for (; idx < Window.size(); ++idx) {
+			const std::vector<Instruction *> &Candidate = Window[idx];
+			CCATentativeMatch &T = Tentative[idx];
+			auto isInSets = [&](Instruction *I) { return FS.RemovedInsts.count(I) != 0 || FS.ReplacedInsts.count(I) != 0 || FS.HoistedInsts.count(I) != 0; };
+			if (!first && std::any_of(Candidate.begin(), Candidate.end(), isInSets)) continue;
+			first = false;
+			if (!FS.Budget.spend()) break;
+			CCAPattern *P = T.P;
+			T.P = nullptr;
+			if (P != nullptr && std::none_of(T.Touched.begin(), T.Touched.end(), isInSets))
+				FS.RemovedInsts.insert(T.Removed.begin(), T.Removed.end());
+			else if (P != nullptr) {
+				delete P;
+				P = CCAPattern::get(G, Candidate, FS.RemovedInsts, FS.ReplacedInsts, S);
+			}
+			if (P != nullptr) {
+				FS.PatternVec.push_back(P);
+				FS.ReplacedInsts.insert(Candidate.begin(), Candidate.end());
+				for (auto mapIter : P->ORVM()) FS.ReplacedInsts.insert(cast<Instruction>(mapIter.second));
+				FS.HoistedInsts.insert(P->hoisted().begin(), P->hoisted().end());
 			}
-			Iter.reset();
 		}
-		if (t) terminated_ = true;
+		for (CCATentativeMatch &T : Tentative) delete T.P;
+		if (idx < Window.size()) return;
 	}
+}
+
+//--------------------------------------------
+// Overlap-Aware Selection for Universal Pass
+//--------------------------------------------
+// Legal match collected from a basic block, with the instructions it erases (sorted) and the values it reads
+struct CCAMatchCandidate {
+	CCAPattern *P;
+	std::vector<Instruction *> Touched; // roots, output registers and removed instructions
+	std::vector<Instruction *> Removed;
+	std::vector<Value *> Inputs;
+	int weight;
+};
 
-	bool valid(void) const {
-		if (terminated_) return false;
-		for (auto &Iter : I_)
-			if (!Iter.valid()) return false;
-		return true;
+// Two matches conflict when they erase a common instruction, or one erases an input of the other
+static std::vector<std::vector<unsigned>> buildConflicts(const std::vector<CCAMatchCandidate> &Matches) {
+	DenseMap<Value *, std::vector<unsigned>> TouchedBy, RemovedBy, ReadBy;
+	std::vector<std::vector<unsigned>> Conflicts(Matches.size());
+	auto link = [&](unsigned i, const std::vector<unsigned> &Others) {
+		for (unsigned j : Others) {
+			Conflicts[i].push_back(j);
+			Conflicts[j].push_back(i);
+		}
+	};
+	for (unsigned i = 0; i < Matches.size(); ++i) {
+		const CCAMatchCandidate &M = Matches[i];
+		for (Instruction *I : M.Touched) link(i, TouchedBy[I]);
+		for (Instruction *I : M.Removed) link(i, ReadBy[I]);
+		for (Value *V : M.Inputs) link(i, RemovedBy[V]);
+		for (Instruction *I : M.Touched) TouchedBy[I].push_back(i);
+		for (Instruction *I : M.Removed) RemovedBy[I].push_back(i);
+		for (Value *V : M.Inputs) ReadBy[V].push_back(i);
+	}
+	for (auto &Adj : Conflicts) {
+		std::sort(Adj.begin(), Adj.end());
+		Adj.erase(std::unique(Adj.begin(), Adj.end()), Adj.end());
 	}
+	return Conflicts;
+}
 
-	bool duplicated(void) const {
-		for (unsigned i = 0; i < I_.size(); ++i) {
-			for (unsigned j = 0; j < I_.size(); ++j) {
-				if (i != j && I_.at(i) == I_.at(j)) return true;
+// Maximum-Weight Independent Set
+// Each connected component of profitable matches starts from the better of the search-order greedy choice and the
+// w/(d+1) greedy choice, which is improved by swapping a chosen match for heavier non-conflicting neighbours.
+// Components of up to 64 matches are then solved exactly by branch and bound on bitmasks within a step budget,
+// so the result is never worse than committing matches in search order.
+class CCAMatchSelector final {
+  private:
+	static const unsigned ExactLimit = 64;
+	static const unsigned StepBudget = 1 << 20;
+	const std::vector<int> &W_;
+	const std::vector<std::vector<unsigned>> &Adj_;
+	std::vector<unsigned> comp_;
+	std::vector<bool> chosen_;
+	std::vector<unsigned> tight_; // number of chosen neighbours
+	std::vector<uint64_t> adjmask_;
+	uint64_t best_;
+	int bestweight_;
+	unsigned steps_;
+
+	bool adjacent(unsigned u, unsigned v) const { return std::binary_search(Adj_[u].begin(), Adj_[u].end(), v); }
+	void choose(unsigned v, bool chosen) {
+		chosen_[v] = chosen;
+		for (unsigned n : Adj_[v]) tight_[n] += chosen ? 1 : -1;
+	}
+	int weight(void) const {
+		int retval = 0;
+		for (unsigned v : comp_) retval += chosen_[v] ? W_[v] : 0;
+		return retval;
+	}
+	void clear(void) {
+		for (unsigned v : comp_)
+			if (chosen_[v]) choose(v, false);
+	}
+
+	// Greedy in Search Order, or by w/(d+1) over the Remaining Matches
+	void greedy(bool byDegree) {
+		clear();
+		std::vector<bool> alive(W_.size(), false);
+		std::vector<long> degree(W_.size(), 1);
+		for (unsigned v : comp_) alive[v] = true;
+		for (unsigned v : comp_)
+			for (unsigned n : Adj_[v]) degree[v] += alive[n];
+		auto kill = [&](unsigned v) {
+			alive[v] = false;
+			for (unsigned n : Adj_[v]) --degree[n];
+		};
+		while (true) {
+			int pick = -1;
+			for (unsigned v : comp_) {
+				if (!alive[v]) continue;
+				if (!byDegree) {
+					pick = v;
+					break;
+				}
+				// maximize w/(d+1) without division
+				if (pick < 0 || (long)W_[v] * degree[pick] > (long)W_[pick] * degree[v]) pick = v;
 			}
+			if (pick < 0) return;
+			choose(pick, true);
+			kill(pick);
+			for (unsigned n : Adj_[pick])
+				if (alive[n]) kill(n);
 		}
-		return false;
 	}
 
-	unsigned size(void) const {
-		unsigned size = 1;
-		for (const auto &Iter : I_) size *= Iter.size();
-		return size;
+	// Replace a Chosen Match by its Neighbours which Conflict Only with it, while the Weight Grows
+	void improve(void) {
+		std::vector<unsigned> Free;
+		bool improved = true;
+		while (improved && steps_ < StepBudget) {
+			improved = false;
+			for (unsigned x : comp_) {
+				if (!chosen_[x]) continue;
+				Free.clear();
+				int gain = -W_[x];
+				for (unsigned n : Adj_[x]) {
+					++steps_;
+					if (chosen_[n] || tight_[n] != 1 || W_[n] <= 0) continue;
+					bool independent = true;
+					for (unsigned f : Free) independent = independent && !adjacent(n, f);
+					if (!independent) continue;
+					Free.push_back(n);
+					gain += W_[n];
+				}
+				if (gain <= 0) continue;
+				choose(x, false);
+				for (unsigned f : Free) choose(f, true);
+				improved = true;
+			}
+		}
 	}
 
-	bool isInSet(const std::set<Instruction *> Set) const {
-		for (auto Iter : I_)
-			if (Set.find(cast<Instruction>(Iter.get())) != Set.end()) return true;
-		return false;
+	void search(uint64_t Open, uint64_t Chosen, int weight) {
+		if (++steps_ > StepBudget) return;
+		if (Open == 0) {
+			if (weight > bestweight_) best_ = Chosen, bestweight_ = weight;
+			return;
+		}
+		int bound = weight;
+		unsigned pick = 0;
+		for (unsigned idx = 0; idx < comp_.size(); ++idx) {
+			if (!(Open >> idx & 1)) continue;
+			bound += W_[comp_[idx]];
+			if (!(Open >> pick & 1) || W_[comp_[idx]] > W_[comp_[pick]]) pick = idx;
+		}
+		if (bound <= bestweight_) return;
+		uint64_t bit = (uint64_t)1 << pick;
+		search(Open & ~bit & ~adjmask_[pick], Chosen | bit, weight + W_[comp_[pick]]);
+		search(Open & ~bit, Chosen, weight);
 	}
 
-	std::vector<Instruction *> get(void) {
-		std::vector<Instruction *> ret;
-		for (const auto &Iter : I_) ret.push_back(cast<Instruction>(Iter.get()));
-		return ret;
+  public:
+	CCAMatchSelector(const std::vector<int> &W, const std::vector<std::vector<unsigned>> &Adj)
+		: W_(W), Adj_(Adj), comp_(), chosen_(W.size(), false), tight_(W.size(), 0), adjmask_(), best_(0), bestweight_(0), steps_(0) {}
+
+	std::vector<unsigned> select(void) {
+		std::vector<unsigned> Selected;
+		std::vector<bool> visited(W_.size(), false);
+		for (unsigned root = 0; root < W_.size(); ++root) {
+			if (visited[root] || W_[root] <= 0) continue;
+			// Collect a Connected Component of Profitable Matches (in search order)
+			comp_.assign(1, root);
+			visited[root] = true;
+			for (unsigned head = 0; head < comp_.size(); ++head)
+				for (unsigned n : Adj_[comp_[head]])
+					if (!visited[n] && W_[n] > 0) visited[n] = true, comp_.push_back(n);
+			std::sort(comp_.begin(), comp_.end());
+			steps_ = 0;
+			// Heuristic Solution
+			greedy(true);
+			int degreeweight = weight();
+			greedy(false);
+			if (degreeweight > weight()) greedy(true);
+			improve();
+			// Branch and Bound from the Heuristic Solution
+			if (comp_.size() <= ExactLimit) {
+				adjmask_.assign(comp_.size(), 0);
+				best_ = 0, bestweight_ = weight(), steps_ = 0;
+				for (unsigned idx = 0; idx < comp_.size(); ++idx) {
+					if (chosen_[comp_[idx]]) best_ |= (uint64_t)1 << idx;
+					for (unsigned jdx = 0; jdx < comp_.size(); ++jdx)
+						if (adjacent(comp_[idx], comp_[jdx])) adjmask_[idx] |= (uint64_t)1 << jdx;
+				}
+				search(comp_.size() == 64 ? ~(uint64_t)0 : (((uint64_t)1 << comp_.size()) - 1), 0, 0);
+				clear();
+				for (unsigned idx = 0; idx < comp_.size(); ++idx)
+					if (best_ >> idx & 1) choose(comp_[idx], true);
+			}
+			for (unsigned v : comp_)
+				if (chosen_[v]) Selected.push_back(v);
+		}
+		std::sort(Selected.begin(), Selected.end());
+		return Selected;
 	}
 };
 
+//--------------------------------------------
+// Reordering for Universal Pass
+//--------------------------------------------
+// Schedule a Block in Linear Time: each instruction is preceded by its operands in the block (phi nodes are not moved,
+// and are not pulled as operands), and otherwise keeps its program order. The order is a depth-first post-order over
+// the operands from each instruction in program order, and is then applied with one move per displaced instruction.
+static void reorderBlock(BasicBlock &BB) {
+	std::vector<Instruction *> Order;
+	SmallPtrSet<Instruction *, 32> Visited;
+	std::vector<std::pair<Instruction *, unsigned>> Stack;
+	for (Instruction &Root : BB) {
+		if (!Visited.insert(&Root).second) continue;
+		Stack.push_back({&Root, 0});
+		while (!Stack.empty()) {
+			Instruction *I = Stack.back().first;
+			unsigned idx = Stack.back().second++;
+			if (idx == I->getNumOperands() || isa<PHINode>(I)) {
+				Order.push_back(I);
+				Stack.pop_back();
+				continue;
+			}
+			Instruction *OPI = dyn_cast<Instruction>(I->getOperand(idx));
+			if (OPI == nullptr || OPI->getParent() != &BB || isa<PHINode>(OPI) || !Visited.insert(OPI).second) continue;
+			Stack.push_back({OPI, 0});
+		}
+	}
+	// Move the Instructions after a Cursor (instructions already in place are not moved)
+	Instruction *Cursor = nullptr;
+	for (Instruction *I : Order) {
+		if (Cursor == nullptr) {
+			if (I != &BB.front()) I->moveBefore(&BB.front());
+		} else if (I->getPrevNode() != Cursor)
+			I->moveAfter(Cursor);
+		Cursor = I;
+	}
+}
+
+//--------------------------------------------
+// Search Budget for Universal Pass
+//--------------------------------------------
+CCASearchBudget::CCASearchBudget(uint64_t candidates, unsigned milliseconds)
+	: candidates_(candidates), spent_(0), timed_(milliseconds != 0),
+	  deadline_(std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds)), exhausted_(false) {}
+
+// Spend a Candidate (false once the budget is exhausted)
+bool CCASearchBudget::spend(void) {
+	if (exhausted_) return false;
+	++spent_;
+	if ((candidates_ != 0 && spent_ > candidates_) || (timed_ && std::chrono::steady_clock::now() >= deadline_)) exhausted_ = true;
+	return !exhausted_;
+}
+
 //--------------------------------------------
 // CCA Universal Pass
 //--------------------------------------------
 // Constructor
-CCAUniversalPass::CCAUniversalPass(std::string patternStr) : patternStr_(patternStr) {
+CCAUniversalPass::CCAUniversalPass(std::string patternStr) : CCAUniversalPass(std::vector<std::string>(1, patternStr)) {}
+
+CCAUniversalPass::CCAUniversalPass(std::vector<std::string> patternStrs) : patternStrs_(patternStrs), G_(), Tree_(nullptr) {
 	/*
 	// Parse Input String
 	std::vector<std::string> tokenVec;
@@ -331,138 +777,412 @@ CCAUniversalPass::CCAUniversalPass(std::string patternStr) : patternStr_(pattern
 	}
 	G_ = new CCAPatternGraph(SubGraphs);
 	*/
-	G_ = parser::parsePatternStr(patternStr);
-	// Verbose
-	outs() << "[PIM-CCA-PASS] Build Pattern Graph using \"" << patternStr << "\"\n";
-	G_->print(2, outs());
+	// Rules which cannot be Parsed or Compiled, or do not Fit the CCA Unit of the Target, are Dropped
+	const CCATarget &Target = CCATarget::get();
+	for (auto Iter = patternStrs_.begin(); Iter != patternStrs_.end();) {
+		CCAPatternGraph *G = parser::parsePatternStr(*Iter);
+		std::string Err;
+		if (G == nullptr) Err = "syntax error";
+		else if (!G->compiled())
+			Err = "too large to compile";
+		else
+			Target.check(*G, Err);
+		if (!Err.empty()) {
+			std::cerr << "[PIM-CCA-PASS][ERROR] rule \"" << *Iter << "\" is dropped: " << Err << "\n";
+			delete G;
+			Iter = patternStrs_.erase(Iter);
+			continue;
+		}
+		G_.push_back(CCAPatternGraphPtr(G));
+		// Verbose
+		outs() << "[PIM-CCA-PASS] Build Pattern Graph using \"" << *Iter << "\"\n";
+		G_.back()->print(2, outs());
+		++Iter;
+	}
+	Tree_ = std::make_shared<const CCADiscriminationTree>(G_);
 }
 
-// Pass Run
-PreservedAnalyses CCAUniversalPass::run(Function &F, FunctionAnalysisManager &) {
-	std::set<Instruction *> RemovedInsts;
-	std::set<Instruction *> ReplacedInsts;
-	std::vector<CCAPattern *> PatternVec;
+// Search Patterns of a Rule
+void CCAUniversalPass::search(unsigned ridx, CCAFunctionSearch &FS, raw_ostream &Log) const {
+	Function &F = FS.F;
+	const CCAPlacement *Placement = FS.Placement.get();
+	const std::vector<BasicBlock *> &Blocks = FS.Blocks;
+	CCASearchBudget &Budget = FS.Budget;
+	std::vector<CCAPattern *> &PatternVec = FS.PatternVec;
+	std::set<Instruction *> &RemovedInsts = FS.RemovedInsts;
+	std::set<Instruction *> &ReplacedInsts = FS.ReplacedInsts;
+	const CCAPatternGraph *G = G_[ridx].get();
+	CCAMatchState S(CCAEGraphMode ? G->eprogram() : G->program());
+	S.setIndex(FS.Index);
+	S.setDeadStores(FS.DeadStores.get());
+	S.setHoisted(&FS.HoistedInsts);
+	const int overhead = CCATarget::get().overhead(*G);
+	S.setPlacement(Placement, overhead);
+	unsigned searched = 0, searchedInsts = 0, totalInsts = 0;
+	for (BasicBlock *BB : Blocks) totalInsts += BB->size();
+	bool prepared = false; // for the workers of the large blocks, at the first one
+	for (BasicBlock *BB : Blocks) {
+		if (Budget.exhausted()) break;
+		// On an E-Graph, Roots are the Instructions whose Class has the Opcode of the Root
+		// (the e-graph is built for each rule, as the earlier rules rewrite the block)
+		std::unique_ptr<CCAEGraph> EG;
+		CCARootCandidates ERoots;
+		if (CCAEGraphMode) {
+			EG.reset(new CCAEGraph(*BB, FS.EGraphConstants, CCAEGraphNodes, CCAEGraphIterations));
+			EG->classify(G->opcode(), ERoots);
+		}
+		S.setEGraph(EG.get());
+		CandidateIter CIter(G->opcode(), G->root_links(), EG ? ERoots : FS.BlockRoots.find(BB)->second.at(ridx), EG.get(), Placement != nullptr);
 
-	outs() << "[PIM-CCA-PASS] Start Pattern Search in Function [" << F.getName() << "] for pattern = \"" << patternStr_ << "\"\n";
-	outs().flush();
-	for (Function::iterator FuncIter = F.begin(); FuncIter != F.end(); ++FuncIter) {
-		CandidateIter CIter(G_->opcode(), FuncIter->begin(), FuncIter->end());
-
-		// unsigned iter = 0, size = CIter.size();
-		while (CIter.valid()) {
-			// Get Patterns using Candidates
-			std::vector<Instruction *> Candidate = CIter.get();
-			/*
-			if (iter % 1000 == 0) {
-				outs() << "  CANDIDATE [" << iter << " / " << size << "] (valid = " << (CIter.valid() ? 'T' : 'F') << "): \n";
-				for (auto *I : Candidate) {
-					outs() << std::string(4, ' ');
-					I->print(outs());
-					outs() << '\n';
+		// Commit the First Match Found for each Candidate
+		if (CCASelectionMode == CCASelection::Greedy && !EG && FS.BlockWorkers != nullptr && BB->size() >= CCABlockSize) {
+			// The matchers only read the IR, the instruction order and the dominator tree, which are numbered first
+			std::vector<std::unique_ptr<CCAMatchState>> &Workers = FS.BlockWorkers->States.at(ridx);
+			if (!prepared) {
+				for (BasicBlock &B : F) B.renumberInstructions();
+				if (Placement != nullptr) Placement->prepare();
+				while (Workers.size() < FS.BlockWorkers->threads) Workers.emplace_back(new CCAMatchState(G->program()));
+				for (auto &W : Workers) {
+					W->setIndex(FS.Index);
+					W->setDeadStores(FS.DeadStores.get());
+					W->setPlacement(Placement, overhead);
 				}
+				prepared = true;
 			}
-			*/
-			CCAPattern *P = CCAPattern::get(G_, Candidate, RemovedInsts, ReplacedInsts);
-			if (P != nullptr) {
-				PatternVec.push_back(P);
-				ReplacedInsts.insert(Candidate.begin(), Candidate.end());
-				auto ORVM = P->ORVM();
-				for (auto mapIter : ORVM) ReplacedInsts.insert(cast<Instruction>(mapIter.second));
+			const unsigned firstPattern = PatternVec.size();
+			std::set<Instruction *> CheckRemoved, CheckReplaced, CheckHoisted;
+			if (CCACheckBlockThreads) CheckRemoved = RemovedInsts, CheckReplaced = ReplacedInsts, CheckHoisted = FS.HoistedInsts;
+			searchParallel(G, CIter, S, Workers, FS.BlockWorkers->Pool, FS);
+			if (!Budget.exhausted()) ++searched, searchedInsts += BB->size();
+
+			// Check the Matches against the Sequential Search (from the sets before the block, and unless the budget cut the block)
+			if (CCACheckBlockThreads && !Budget.exhausted()) {
+				std::vector<CCAPattern *> CheckVec;
+				CandidateIter CheckIter(G->opcode(), G->root_links(), FS.BlockRoots.find(BB)->second.at(ridx), nullptr, Placement != nullptr);
+				S.setHoisted(&CheckHoisted);
+				searchGreedy(G, CheckIter, S, nullptr, CheckVec, CheckRemoved, CheckReplaced, CheckHoisted);
+				S.setHoisted(&FS.HoistedInsts);
+				bool same = CheckVec.size() == PatternVec.size() - firstPattern && CheckRemoved == RemovedInsts && CheckReplaced == ReplacedInsts && CheckHoisted == FS.HoistedInsts;
+				for (unsigned idx = 0; same && idx < CheckVec.size(); ++idx) {
+					const CCAPattern *P = PatternVec[firstPattern + idx];
+					same = CheckVec[idx]->IRVM() == P->IRVM() && CheckVec[idx]->ORVM() == P->ORVM();
+				}
+				for (CCAPattern *P : CheckVec) delete P;
+				if (same)
+					Log << "[PIM-CCA-PASS] Checked " << CheckVec.size() << " Matches of Block [" << BB->getName() << "] against the sequential search\n";
+				else
+					Log << "[PIM-CCA-PASS][ERROR] The parallel search of Block [" << BB->getName() << "] differs from the sequential search\n";
+			}
+			continue;
+		}
+		if (CCASelectionMode == CCASelection::Greedy) {
+			searchGreedy(G, CIter, S, &Budget, PatternVec, RemovedInsts, ReplacedInsts, FS.HoistedInsts);
+			if (!Budget.exhausted()) ++searched, searchedInsts += BB->size();
+			continue;
+		}
+
+		// Collect All Legal Matches of the Block (every distinct binding of each candidate)
+		std::vector<CCAMatchCandidate> Matches;
+		const std::set<Instruction *> NoReplaced;
+		std::set<Instruction *> MatchRemoved;
+		while (CIter.valid() && Budget.spend()) {
+			const std::vector<Instruction *> &Candidate = CIter.get();
+			unsigned first = Matches.size();
+			CCAPattern *P = nullptr;
+			for (bool next = false; (P = CCAPattern::get(G, Candidate, MatchRemoved, NoReplaced, S, next)) != nullptr; next = true) {
+				CCAMatchCandidate M = {P, {}, std::vector<Instruction *>(MatchRemoved.begin(), MatchRemoved.end()), {}, -overhead};
+				MatchRemoved.clear();
+				M.Touched = M.Removed;
+				M.Touched.insert(M.Touched.end(), Candidate.begin(), Candidate.end());
+				for (auto mapIter : P->ORVM()) M.Touched.push_back(cast<Instruction>(mapIter.second));
+				std::sort(M.Touched.begin(), M.Touched.end());
+				M.Touched.erase(std::unique(M.Touched.begin(), M.Touched.end()), M.Touched.end());
+				for (auto mapIter : P->IRVM()) M.Inputs.push_back(mapIter.second);
+				for (Instruction *I : M.Touched) M.weight += CCAPlacement::estimateCycles(I);
+				// The moved instructions are not saved, but another match may not replace them
+				if (!P->hoisted().empty()) {
+					M.Touched.insert(M.Touched.end(), P->hoisted().begin(), P->hoisted().end());
+					std::sort(M.Touched.begin(), M.Touched.end());
+					M.Touched.erase(std::unique(M.Touched.begin(), M.Touched.end()), M.Touched.end());
+				}
+				// Bindings erasing the same instructions are kept only once (the first, as the greedy search would take)
+				bool duplicated = false;
+				for (unsigned idx = first; idx < Matches.size() && !duplicated; ++idx) duplicated = Matches[idx].Touched == M.Touched;
+				if (duplicated) delete P;
+				else
+					Matches.push_back(M);
 			}
-			// Update Iterators
 			CIter.increase();
-			while (CIter.valid() && (CIter.duplicated() || CIter.isInSet(RemovedInsts) || CIter.isInSet(ReplacedInsts))) CIter.increase();
-			// ++iter;
+			while (CIter.valid() && CIter.duplicated()) CIter.increase();
+		}
+		if (!Budget.exhausted()) ++searched, searchedInsts += BB->size();
+		if (Matches.empty()) continue;
+
+		// Choose Non-Overlapping Matches with the Most Estimated Cycles Saved
+		std::vector<int> Weights;
+		for (auto &M : Matches) Weights.push_back(M.weight);
+		std::vector<std::vector<unsigned>> Conflicts = buildConflicts(Matches);
+		std::vector<unsigned> Selected = CCAMatchSelector(Weights, Conflicts).select();
+		int saved = 0;
+		for (unsigned idx : Selected) {
+			CCAMatchCandidate &M = Matches[idx];
+			PatternVec.push_back(M.P);
+			RemovedInsts.insert(M.Removed.begin(), M.Removed.end());
+			for (Instruction *I : M.Touched)
+				if (std::find(M.P->hoisted().begin(), M.P->hoisted().end(), I) != M.P->hoisted().end()) FS.HoistedInsts.insert(I);
+				else if (!std::binary_search(M.Removed.begin(), M.Removed.end(), I))
+					ReplacedInsts.insert(I);
+			M.P = nullptr;
+			saved += M.weight;
 		}
+		for (auto &M : Matches) delete M.P;
+		Log << "[PIM-CCA-PASS] Selected " << Selected.size() << " of " << Matches.size() << " Matches in Block [" << BB->getName()
+			   << "], estimated " << saved << " cycles saved\n";
 	}
 
+	// Coverage of a Limited or Ordered Search
+	if (Budget.limited() || CCAHotFirst)
+		Log << "[PIM-CCA-PASS] Searched " << searched << " of " << Blocks.size() << " Blocks (" << searchedInsts << " of " << totalInsts
+			   << " Instructions) in Function [" << F.getName() << "]" << (Budget.exhausted() ? ", search budget exhausted\n" : "\n");
+}
+
+// Build the Found Patterns of a Rule, and Remove the Replaced Instructions
+void CCAUniversalPass::commit(unsigned ridx, CCAFunctionSearch &FS, std::set<Instruction *> &ErasedInsts, raw_ostream &Log) const {
+	Function &F = FS.F;
+	std::vector<CCAPattern *> &PatternVec = FS.PatternVec;
+	std::set<Instruction *> &RemovedInsts = FS.RemovedInsts;
+	std::set<Instruction *> &ReplacedInsts = FS.ReplacedInsts;
 	// Verbose
 	if (!PatternVec.empty()) {
-		outs() << "[PIM-CCA-PASS] Found Patterns in Function [" << F.getName() << "], pattern = \"" << patternStr_ << "\"\n";
-		outs().flush();
-		outs() << "  - removed: \n";
+		Log << "[PIM-CCA-PASS] Found Patterns in Function [" << F.getName() << "], pattern = \"" << patternStrs_[ridx] << "\"\n";
+		Log.flush();
+		Log << "  - removed: \n";
 		for (const auto &iter : RemovedInsts) {
-			outs() << std::string(4, ' ');
-			iter->print(outs());
-			outs() << '\n';
+			Log << std::string(4, ' ');
+			iter->print(Log);
+			Log << '\n';
 		}
-		outs().flush();
-		outs() << "  - replaced: \n";
+		Log.flush();
+		Log << "  - replaced: \n";
 		for (const auto &iter : ReplacedInsts) {
-			outs() << std::string(4, ' ');
-			iter->print(outs());
-			outs() << '\n';
+			Log << std::string(4, ' ');
+			iter->print(Log);
+			Log << '\n';
 		}
-		outs().flush();
+		Log.flush();
 	}
 
 	// Build CCA Instructions from Patterns
-	for (auto &P : PatternVec) P->build(G_->rule_number(), F.getContext());
+	for (auto &P : PatternVec) P->build(G_[ridx]->rule_number(), F.getContext());
 	for (auto &P : PatternVec) P->resolve();
 
 	// Remove Intermediate Instructions
+	ErasedInsts.insert(ReplacedInsts.begin(), ReplacedInsts.end());
 	for (auto &I : ReplacedInsts) I->eraseFromParent();
-	bool changed = true;
-	while (changed) {
-		changed = false;
-		std::vector<Instruction *> Removable;
-		for (auto &I : RemovedInsts) {
-			if (I->users().empty()) Removable.push_back(I);
-		}
-		for (auto &I : Removable) {
-			RemovedInsts.erase(I);
-			I->eraseFromParent();
-			changed = true;
+	// An intermediate instruction is erased once its last user is erased: the worklist starts from the dead ones,
+	// and erasing an instruction queues its operands in the remove list which become dead (each is queued once)
+	std::vector<Instruction *> Worklist;
+	for (auto &I : RemovedInsts)
+		if (I->use_empty()) Worklist.push_back(I);
+	for (auto &I : Worklist) RemovedInsts.erase(I);
+	while (!Worklist.empty()) {
+		Instruction *I = Worklist.back();
+		Worklist.pop_back();
+		SmallVector<Instruction *, 4> Operands;
+		for (Value *V : I->operands())
+			if (isa<Instruction>(V) && RemovedInsts.find(cast<Instruction>(V)) != RemovedInsts.end()) Operands.push_back(cast<Instruction>(V));
+		ErasedInsts.insert(I);
+		I->eraseFromParent();
+		for (Instruction *OPI : Operands) {
+			if (!OPI->use_empty() || RemovedInsts.erase(OPI) == 0) continue;
+			Worklist.push_back(OPI);
 		}
 	}
 
 	if (!RemovedInsts.empty()) {
-		outs() << "[PIM-CCA-PASS][ERROR] Cannot Resolve All the Intermediate Instructions\n";
-		outs().flush();
+		Log << "[PIM-CCA-PASS][ERROR] Cannot Resolve All the Intermediate Instructions\n";
+		Log.flush();
 		for (const auto &I : RemovedInsts) {
-			I->print(outs());
-			outs() << '\n';
+			I->print(Log);
+			Log << '\n';
 			for (const auto &V : I->users()) {
-				outs() << "  - ";
-				V->print(outs());
-				outs() << '\n';
+				Log << "  - ";
+				V->print(Log);
+				Log << '\n';
 			}
 		}
 	}
 
-	// Reorder Instructions
-	for (Function::iterator FuncIter = F.begin(); FuncIter != F.end(); ++FuncIter) {
-		bool changed = true;
-		while (changed) {
-			changed = false;
-			for (BasicBlock::iterator BBIter = FuncIter->begin(); BBIter != FuncIter->end(); ++BBIter) {
-				Instruction *I = cast<Instruction>(BBIter);
-				if (isa<PHINode>(I)) continue;
-				for (unsigned idx = 0; idx < I->getNumOperands(); ++idx) {
-					Value *V = I->getOperand(idx);
-					if (!isa<Instruction>(V)) continue;
-					if (isa<PHINode>(V)) continue;
-					Instruction *OPI = cast<Instruction>(V);
-					if (OPI->getParent() == I->getParent() && !OPI->comesBefore(I)) {
-						/*
-						outs() << "[PASS] Fix Instruction Orders\n";
-						I->print(outs());
-						outs() << '\n';
-						OPI->print(outs());
-						outs() << '\n';
-						*/
-						OPI->moveBefore(I);
-						changed = true;
-					}
+	for (auto &P : PatternVec) P->prune();
+
+	// Reorder Instructions in the Blocks where CCA Instructions were Inserted
+	SmallPtrSet<BasicBlock *, 8> Touched;
+	for (auto &P : PatternVec)
+		if (P->getParent() != nullptr) Touched.insert(P->getParent());
+	for (BasicBlock &BB : F)
+		if (Touched.count(&BB)) reorderBlock(BB);
+}
+
+// Fetch the Analyses and Classify the Root Candidates of All Rules in a Single Traversal
+std::unique_ptr<CCAFunctionSearch> CCAUniversalPass::begin(Function &F, FunctionAnalysisManager &FAM) const {
+	std::unique_ptr<CCAFunctionSearch> S(new CCAFunctionSearch(F, FAM.getResult<CCACandidateIndexAnalysis>(F), CCACandidateBudget, CCATimeBudget));
+	for (BasicBlock &BB : F) Tree_->classify(BB, *S->Index, S->BlockRoots[&BB]);
+	if (CCAEGraphMode) S->EGraphConstants = getEGraphConstants(F.getContext());
+
+	// Matches Spanning Blocks are Placed by Dominance and Block Frequency (the rewrites keep the control flow)
+	if (CCACrossBlock && !CCAEGraphMode)
+		S->Placement.reset(new CCAPlacement(FAM.getResult<DominatorTreeAnalysis>(F), FAM.getResult<BlockFrequencyAnalysis>(F)));
+
+	// Blocks in Search Order: hottest first (by block frequency with a profile, or else by loop depth), ties in function order
+	std::vector<BasicBlock *> &Blocks = S->Blocks;
+	for (BasicBlock &BB : F) Blocks.push_back(&BB);
+	if (CCAHotFirst) {
+		DenseMap<BasicBlock *, uint64_t> Hotness;
+		if (F.hasProfileData()) {
+			BlockFrequencyInfo &BFI = FAM.getResult<BlockFrequencyAnalysis>(F);
+			for (BasicBlock *BB : Blocks) Hotness[BB] = BFI.getBlockFreq(BB).getFrequency();
+		} else {
+			LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+			for (BasicBlock *BB : Blocks) Hotness[BB] = LI.getLoopDepth(BB);
+		}
+		std::stable_sort(Blocks.begin(), Blocks.end(), [&](BasicBlock *A, BasicBlock *B) { return Hotness[A] > Hotness[B]; });
+	}
+	return S;
+}
+
+void CCAUniversalPass::beginRule(unsigned ridx, CCAFunctionSearch &S, FunctionAnalysisManager &FAM, raw_ostream &Log) const {
+	Function &F = S.F;
+	Log << "[PIM-CCA-PASS] Start Pattern Search in Function [" << F.getName() << "] for pattern = \"" << patternStrs_[ridx] << "\"\n";
+	Log.flush();
+	// The stores overwritten by a later store change with the rewrites, so the index of the last rule is dropped
+	if (S.rewritten) {
+		PreservedAnalyses PA = PreservedAnalyses::all();
+		PA.abandon<CCACandidateIndexAnalysis>();
+		FAM.invalidate(F, PA);
+		S.Index = &FAM.getResult<CCACandidateIndexAnalysis>(F);
+		S.rewritten = false;
+	}
+	// The analyses are fetched here, as the search (on the threads of the module pass) may not use the analysis manager
+	if (CCAMemorySSA) {
+		S.AA = &FAM.getResult<AAManager>(F);
+		S.DT = &FAM.getResult<DominatorTreeAnalysis>(F);
+		S.PDT = &FAM.getResult<PostDominatorTreeAnalysis>(F);
+	}
+}
+
+// The dead stores are answered for each rule, as the earlier rules rewrite the function (but not its control flow).
+// MemorySSA is built on the thread of the function, and only reads the IR and the analyses of the function.
+void CCAUniversalPass::searchRule(unsigned ridx, CCAFunctionSearch &S, raw_ostream &Log) const {
+	S.DeadStores.reset();
+	if (S.AA != nullptr) S.DeadStores.reset(new CCADeadStores(S.F, *S.AA, *S.DT, *S.PDT));
+	search(ridx, S, Log);
+}
+
+void CCAUniversalPass::commitRule(unsigned ridx, CCAFunctionSearch &S, raw_ostream &Log) const {
+	std::set<Instruction *> ErasedInsts;
+	if (!S.PatternVec.empty()) {
+		commit(ridx, S, ErasedInsts, Log);
+		S.changed = true;
+		S.rewritten = true;
+
+		// Erased Instructions are not Candidates of the Later Rules, and the Others are Kept in the Reordered Program Order
+		for (auto &BlockIter : S.BlockRoots) {
+			for (unsigned later = ridx + 1; later < G_.size(); ++later) {
+				for (auto &Candidates : BlockIter.second.at(later)) {
+					Candidates.erase(std::remove_if(Candidates.begin(),
+													Candidates.end(),
+													[&](Instruction *I) { return ErasedInsts.find(I) != ErasedInsts.end(); }),
+									 Candidates.end());
+					std::stable_sort(Candidates.begin(), Candidates.end(), [](Instruction *A, Instruction *B) { return A->comesBefore(B); });
 				}
-				if (changed) break;
 			}
 		}
 	}
+	S.DeadStores.reset();
+	S.PatternVec.clear();
+	S.RemovedInsts.clear();
+	S.ReplacedInsts.clear();
+	S.HoistedInsts.clear();
+}
+
+// The rewrites keep the control flow, but invalidate the instruction-level analyses (and the candidate index)
+static PreservedAnalyses getPreservedAnalyses(bool changed) {
+	if (!changed) return PreservedAnalyses::all();
+	PreservedAnalyses PA = PreservedAnalyses::none();
+	PA.preserveSet<CFGAnalyses>();
+	return PA;
+}
+
+// Workers of the Large Blocks, Started at the First Run which Needs them (none with one block thread)
+CCABlockWorkers *CCAUniversalPass::blockWorkers(void) {
+	const unsigned threads = hardware_concurrency(CCABlockThreads).compute_thread_count();
+	if (threads <= 1) return nullptr;
+	if (BlockWorkers_ == nullptr) BlockWorkers_ = std::make_shared<CCABlockWorkers>(threads, G_.size());
+	return BlockWorkers_.get();
+}
+
+// Pass Run
+PreservedAnalyses CCAUniversalPass::run(Function &F, FunctionAnalysisManager &FAM) {
+	// Search and Commit the Rules in Order
+	std::unique_ptr<CCAFunctionSearch> S = begin(F, FAM);
+	S->BlockWorkers = blockWorkers();
+	for (unsigned ridx = 0; ridx < G_.size(); ++ridx) {
+		beginRule(ridx, *S, FAM, outs());
+		searchRule(ridx, *S, outs());
+		commitRule(ridx, *S, outs());
+	}
+	return getPreservedAnalyses(S->changed);
+}
 
-	// F.print(outs());
+//--------------------------------------------
+// CCA Universal Module Pass
+//--------------------------------------------
+// Pass Run: the messages of each function are kept, and printed in module order at the end
+PreservedAnalyses CCAUniversalModulePass::run(Module &M, ModuleAnalysisManager &MAM) {
+	FunctionAnalysisManager &FAM = MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+	std::vector<std::unique_ptr<CCAFunctionSearch>> Searches;
+	for (Function &F : M)
+		if (!F.isDeclaration()) Searches.push_back(Pass_.begin(F, FAM));
+	std::vector<std::string> Logs(Searches.size());
+	std::vector<std::unique_ptr<raw_string_ostream>> LogStreams;
+	for (std::string &Log : Logs) LogStreams.emplace_back(new raw_string_ostream(Log));
+
+	// The threads of a block would be started by each thread of the module, so with several threads of the module
+	// the blocks are searched by the thread of their function
+	ThreadPool Pool(hardware_concurrency(CCAThreads));
+	const unsigned threads = hardware_concurrency(CCAThreads).compute_thread_count();
+	if (threads > 1 && hardware_concurrency(CCABlockThreads).compute_thread_count() > 1)
+		std::cerr << "[PIM-CCA-PASS][WARNING] -cca-block-threads=" << CCABlockThreads << " is ignored, as -cca-threads=" << CCAThreads
+				  << " searches the functions in parallel\n";
+	else
+		for (auto &S : Searches) S->BlockWorkers = Pass_.blockWorkers();
+	for (unsigned ridx = 0; ridx < Pass_.size(); ++ridx) {
+		for (unsigned fidx = 0; fidx < Searches.size(); ++fidx) Pass_.beginRule(ridx, *Searches[fidx], FAM, *LogStreams[fidx]);
+		// Largest Functions First, so a large function does not start last
+		std::vector<unsigned> Order(Searches.size());
+		for (unsigned fidx = 0; fidx < Order.size(); ++fidx) Order[fidx] = fidx;
+		std::stable_sort(Order.begin(), Order.end(), [&](unsigned A, unsigned B) {
+			return Searches[A]->F.getInstructionCount() > Searches[B]->F.getInstructionCount();
+		});
+		for (unsigned fidx : Order) Pool.async([&, fidx]() { Pass_.searchRule(ridx, *Searches[fidx], *LogStreams[fidx]); });
+		Pool.wait();
+		for (unsigned fidx = 0; fidx < Searches.size(); ++fidx) Pass_.commitRule(ridx, *Searches[fidx], *LogStreams[fidx]);
+	}
 
-	return PreservedAnalyses::all();
+	bool changed = false;
+	for (unsigned fidx = 0; fidx < Searches.size(); ++fidx) {
+		outs() << LogStreams[fidx]->str();
+		if (!Searches[fidx]->changed) continue;
+		FAM.invalidate(Searches[fidx]->F, getPreservedAnalyses(true));
+		changed = true;
+	}
+	outs().flush();
+	if (!changed) return PreservedAnalyses::all();
+	// The function analyses were invalidated above, function by function
+	PreservedAnalyses PA = PreservedAnalyses::none();
+	PA.preserveSet<AllAnalysesOn<Function>>();
+	PA.preserve<FunctionAnalysisManagerModuleProxy>();
+	return PA;
 }
 
 } // namespace cca
@@ -1,10 +1,19 @@
 #ifndef PIMCCALLVMPASS_INSTRUMENTATION_CCA_UNIVERSL_PASS_HPP_
 #define PIMCCALLVMPASS_INSTRUMENTATION_CCA_UNIVERSL_PASS_HPP_
 
+#include "Instrumentation/CCADeadStores.hpp"
+#include "Instrumentation/CCADiscriminationTree.hpp"
+#include "Instrumentation/CCAEGraph.hpp"
 #include "Instrumentation/CCAPatternGraph.hpp"
+#include "Instrumentation/CCAPlacement.hpp"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/PassManager.h"
+#include "llvm/Support/ThreadPool.h"
+#include <chrono>
+#include <memory>
 
 namespace llvm {
 namespace cca {
@@ -16,34 +25,139 @@ class CCAPattern final {
   private:
 	std::map<unsigned int, Value *> InputRegValueMap_;
 	std::map<unsigned int, Value *> OutputRegValueMap_;
-	std::vector<Instruction *> CCAOutputInst_;
+	CallInst *CCAOutputMoveInst_;
+	std::vector<Instruction *> CCAOutputInst_; // extracted outputs
+	Instruction *InsertPos_;				   // placed insertion point of a match spanning blocks
+	std::vector<Instruction *> Hoisted_;	   // moved above the insertion point with the inputs, by reorderBlock
 
-	CCAPattern(const std::vector<Instruction *> Candidate) : InputRegValueMap_(), OutputRegValueMap_(), CCAOutputInst_() {}
+	CCAPattern(const std::vector<Instruction *> Candidate)
+		: InputRegValueMap_(), OutputRegValueMap_(), CCAOutputMoveInst_(nullptr), CCAOutputInst_(), InsertPos_(nullptr), Hoisted_() {}
 
   public:
 	~CCAPattern() {}
 	void print(unsigned int indent, std::ostream &os) const;
-	static CCAPattern *get(CCAPatternGraph *Graph,
+	static CCAPattern *get(const CCAPatternGraph *Graph,
 						   const std::vector<Instruction *> &Candidate,
 						   std::set<Instruction *> &Removed,
-						   const std::set<Instruction *> &UnRemovable);
+						   const std::set<Instruction *> &UnRemovable,
+						   CCAMatchState &S,
+						   bool next = false);
 	void build(unsigned int ccaid, LLVMContext &Context);
 	void resolve(void);
+	void prune(void);
+	const std::map<unsigned int, Value *> &IRVM(void) const { return InputRegValueMap_; }
 	const std::map<unsigned int, Value *> &ORVM(void) const { return OutputRegValueMap_; }
+	const std::vector<Instruction *> &hoisted(void) const { return Hoisted_; }
+	BasicBlock *getParent(void) const { return CCAOutputMoveInst_ == nullptr ? nullptr : CCAOutputMoveInst_->getParent(); }
+};
+
+//-------------------------------------
+// Class: CCA Search Budget
+//-------------------------------------
+// Candidates and time the search of a function may spend over all its rules (0 is unlimited)
+class CCASearchBudget final {
+  private:
+	const uint64_t candidates_;
+	uint64_t spent_;
+	const bool timed_;
+	const std::chrono::steady_clock::time_point deadline_;
+	bool exhausted_;
+
+  public:
+	CCASearchBudget(uint64_t candidates, unsigned milliseconds);
+	bool spend(void);
+	bool limited(void) const { return candidates_ != 0 || timed_; }
+	bool exhausted(void) const { return exhausted_; }
+};
+
+//-------------------------------------
+// Class: CCA Block Workers
+//-------------------------------------
+// Threads searching the candidates of a large block, with a match state of each thread for each rule.
+// They are created once for the pass, and used by the search of one function at a time.
+struct CCABlockWorkers {
+	ThreadPool Pool;
+	unsigned threads;
+	std::vector<std::vector<std::unique_ptr<CCAMatchState>>> States; // of each rule, created at its first large block
+
+	CCABlockWorkers(unsigned threads, unsigned rules) : Pool(hardware_concurrency(threads)), threads(threads), States(rules) {}
+};
+
+//-------------------------------------
+// Class: CCA Function Search
+//-------------------------------------
+// Search state of a function across the rules (the analyses are fetched before the search, which only reads the IR)
+struct CCAFunctionSearch {
+	Function &F;
+	const CCACandidateIndex *Index; // rebuilt for the rules after a rewrite
+	std::unique_ptr<CCAPlacement> Placement;
+	std::vector<BasicBlock *> Blocks;
+	CCASearchBudget Budget;
+	DenseMap<BasicBlock *, std::vector<CCARootCandidates>> BlockRoots;
+	CCAEGraphConstants EGraphConstants;
+	CCABlockWorkers *BlockWorkers; // searching a large block (none to search it on the thread of the function)
+	bool changed;
+	bool rewritten; // by the last rule
+	// Of the current rule (the analyses are fetched by beginRule, and the dead stores answered by the search)
+	AAResults *AA;
+	DominatorTree *DT;
+	PostDominatorTree *PDT;
+	std::unique_ptr<CCADeadStores> DeadStores;
+	std::vector<CCAPattern *> PatternVec;
+	std::set<Instruction *> RemovedInsts;
+	std::set<Instruction *> ReplacedInsts;
+	std::set<Instruction *> HoistedInsts; // moved above the insertion point of a match (not erased)
+
+	CCAFunctionSearch(Function &F, const CCACandidateIndex &Index, uint64_t candidates, unsigned milliseconds)
+		: F(F), Index(&Index), Placement(), Blocks(), Budget(candidates, milliseconds), BlockRoots(), EGraphConstants(), BlockWorkers(nullptr), changed(false), rewritten(false), AA(nullptr), DT(nullptr), PDT(nullptr),
+		  DeadStores(),
+		  PatternVec(), RemovedInsts(), ReplacedInsts(), HoistedInsts() {}
 };
 
 //-------------------------------------
 // Class: CCA Universal Pass
 //-------------------------------------
+// Searches all the rules in one pass: the root candidates of every rule are classified in a single traversal,
+// and then each rule is searched and committed in order. Copies of the pass share the compiled rules.
 class CCAUniversalPass : public PassInfoMixin<CCAUniversalPass> {
   private:
-	const std::string patternStr_;
-	CCAPatternGraph *G_;
+	std::vector<std::string> patternStrs_;
+	std::vector<CCAPatternGraphPtr> G_;
+	std::shared_ptr<const CCADiscriminationTree> Tree_;
+	std::shared_ptr<CCABlockWorkers> BlockWorkers_;
+
+	void search(unsigned ridx, CCAFunctionSearch &S, raw_ostream &Log) const;
+	void commit(unsigned ridx, CCAFunctionSearch &S, std::set<Instruction *> &ErasedInsts, raw_ostream &Log) const;
 
   public:
 	CCAUniversalPass(std::string patternStr);
+	CCAUniversalPass(std::vector<std::string> patternStrs);
 	PreservedAnalyses run(Function &, FunctionAnalysisManager &);
 	static bool isRequired(void) { return true; }
+
+	// Phases of a Run: only searchRule may run on several functions at once, the others use the analysis manager or
+	// rewrite the IR (and the LLVM context)
+	unsigned size(void) const { return G_.size(); }
+	std::unique_ptr<CCAFunctionSearch> begin(Function &F, FunctionAnalysisManager &FAM) const;
+	void beginRule(unsigned ridx, CCAFunctionSearch &S, FunctionAnalysisManager &FAM, raw_ostream &Log) const;
+	void searchRule(unsigned ridx, CCAFunctionSearch &S, raw_ostream &Log) const;
+	CCABlockWorkers *blockWorkers(void);
+	void commitRule(unsigned ridx, CCAFunctionSearch &S, raw_ostream &Log) const;
+};
+
+//-------------------------------------
+// Class: CCA Universal Module Pass
+//-------------------------------------
+// Runs the universal pass on all the functions of a module: for each rule, the functions are searched on a thread pool
+// (-cca-threads), and then committed one by one in module order, so the result is the same as the function pass
+class CCAUniversalModulePass : public PassInfoMixin<CCAUniversalModulePass> {
+  private:
+	CCAUniversalPass Pass_;
+
+  public:
+	CCAUniversalModulePass(std::vector<std::string> patternStrs) : Pass_(patternStrs) {}
+	PreservedAnalyses run(Module &, ModuleAnalysisManager &);
+	static bool isRequired(void) { return true; }
 };
 
 } // namespace cca
@@ -1,4 +1,7 @@
 #include "llvm/Passes/PassPlugin.h"
+#include "Instrumentation/CCACandidateIndex.hpp"
+#include "Instrumentation/CCAIntrinsics.hpp"
+#include "Instrumentation/CCARuleLibrary.hpp"
 #include "Instrumentation/CCAUniversal.hpp"
 #include "Instrumentation/Fixed/CCAFixedPasses.hpp"
 #include "llvm/Passes/PassBuilder.h"
@@ -8,10 +11,22 @@ using namespace llvm;
 // Pass Registration
 PassPluginLibraryInfo getPassPluginInfo() {
 	const auto callback = [](PassBuilder &PB) {
-		PB.registerOptimizerLastEPCallback([&](ModulePassManager &MPM, auto) {
-			MPM.addPass(createModuleToFunctionPassAdaptor(cca::CCAUniversalPass("7: o24 = i24 + i25 + i26 + i27 + i28")));
-			// MPM.addPass(createModuleToFunctionPassAdaptor(cca::CCAUniversalPass("8: o24 = i24 + i28; o25 = i25 + o24; o26 = i26 + o25; o27 = i27 + o26")));
-			// MPM.addPass(createModuleToFunctionPassAdaptor(cca::CCAUniversalPass("9: t24 = i24 > i25 ? i24 : i25; o24 = t24 > i26 ? t24 : i26")));
+		PB.registerAnalysisRegistrationCallback([](FunctionAnalysisManager &FAM) { FAM.registerPass([] { return cca::CCACandidateIndexAnalysis(); }); });
+		// The rules are searched before the vectorizer, so the scalar passes which follow clean up around the cca sites,
+		// and the sites are only lowered at the end of the pipeline
+		PB.registerVectorizerStartEPCallback([&](FunctionPassManager &FPM, auto) {
+			// Rules of the library file (-cca-rules or CCA_RULE_LIBRARY), or the default rule 7
+			FPM.addPass(cca::CCAUniversalPass(cca::CCARuleLibrary::get().rules()));
+		});
+		PB.registerOptimizerLastEPCallback([&](ModulePassManager &MPM, auto) { MPM.addPass(cca::CCALowerIntrinsicsPass()); });
+		PB.registerPipelineParsingCallback([](StringRef Name, ModulePassManager &MPM, ArrayRef<PassBuilder::PipelineElement>) {
+			// The module pass searches the functions in parallel (-cca-threads), for the pipelines given by -passes
+			if (Name == "cca-universal") {
+				MPM.addPass(cca::CCAUniversalModulePass(cca::CCARuleLibrary::get().rules()));
+				return true;
+			}
+			if (Name != "cca-lower-intrinsics") return false;
+			MPM.addPass(cca::CCALowerIntrinsicsPass());
 			return true;
 		});
 	};
@@ -0,0 +1,195 @@
+// Usage: RemoveComment [-j <threads>] <file>...
+//        RemoveComment [-j <threads>] --compiler-args <compiler arguments>
+//
+// Strips the "#removethiscomment " and "//removethiscomment " markers which keep the cca instructions as comments
+// through the compiler, so that they are assembled. Each file is mapped and scanned once, rewritten only if it has
+// markers, and the files are processed in parallel. With --compiler-args, the files are the outputs of the compiler
+// invocation (the -o file, or the .s files named after the inputs without -o). The assembler drops the markers with the
+// cca instructions, so an invocation compiling sources without -S is an error, and so is a marker found in a binary file.
+// The exit code is nonzero if any file had an error.
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const std::string Markers[] = {"#removethiscomment ", "//removethiscomment "};
+
+//-------------------------------------
+// Files
+//-------------------------------------
+std::mutex ErrorMutex;
+
+bool error(const std::string &path, const std::string &message) {
+	std::lock_guard<std::mutex> Lock(ErrorMutex);
+	std::cerr << "[PIM-CCA-PASS][ERROR] " << path << ": " << message << "\n";
+	return false;
+}
+
+bool hasSuffix(const std::string &str, const std::string &suffix) {
+	return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool isAssembly(const std::string &path) { return hasSuffix(path, ".s") || hasSuffix(path, ".S") || hasSuffix(path, ".asm"); }
+
+// Read-Only Mapping of a File
+class MappedFile final {
+  private:
+	int fd_;
+	const char *data_;
+	size_t size_;
+
+  public:
+	MappedFile(const std::string &path) : fd_(open(path.c_str(), O_RDONLY)), data_(nullptr), size_(0) {
+		struct stat st;
+		if (fd_ < 0 || fstat(fd_, &st) != 0) return;
+		size_ = st.st_size;
+		if (size_ == 0) return;
+		void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+		if (addr != MAP_FAILED) data_ = static_cast<const char *>(addr);
+	}
+	~MappedFile() {
+		if (data_ != nullptr) munmap(const_cast<char *>(data_), size_);
+		if (fd_ >= 0) close(fd_);
+	}
+	bool valid(void) const { return fd_ >= 0 && (size_ == 0 || data_ != nullptr); }
+	const char *begin(void) const { return data_; }
+	const char *end(void) const { return data_ + size_; }
+};
+
+// Find the Next Marker (nullptr if none), with its Length
+const char *findMarker(const char *pos, const char *end, size_t &length) {
+	for (; pos < end; ++pos) {
+		if (*pos != '#' && *pos != '/') continue;
+		for (const std::string &Marker : Markers) {
+			if ((size_t)(end - pos) >= Marker.size() && std::memcmp(pos, Marker.data(), Marker.size()) == 0) {
+				length = Marker.size();
+				return pos;
+			}
+		}
+	}
+	return nullptr;
+}
+
+// Strip the Markers of an Assembly File (written to a temporary file renamed over it), or Check a Binary File has None
+bool process(const std::string &path) {
+	MappedFile File(path);
+	if (!File.valid()) return error(path, std::strerror(errno));
+	size_t length = 0;
+	const char *pos = File.begin(), *marker = findMarker(pos, File.end(), length);
+	if (marker == nullptr) return true;
+	if (!isAssembly(path)) return error(path, "cca instructions were left as comments in a binary output (compile with -S)");
+
+	std::string tmppath = path + ".cca.XXXXXX";
+	std::vector<char> tmpname(tmppath.begin(), tmppath.end());
+	tmpname.push_back('\0');
+	int fd = mkstemp(tmpname.data());
+	if (fd < 0) return error(path, std::strerror(errno));
+	FILE *Out = fdopen(fd, "w");
+	if (Out == nullptr) {
+		close(fd);
+		unlink(tmpname.data());
+		return error(path, std::strerror(errno));
+	}
+	while (marker != nullptr) {
+		fwrite(pos, 1, marker - pos, Out);
+		pos = marker + length;
+		marker = findMarker(pos, File.end(), length);
+	}
+	fwrite(pos, 1, File.end() - pos, Out);
+	struct stat st;
+	if (stat(path.c_str(), &st) == 0) fchmod(fd, st.st_mode & 07777);
+	bool written = !ferror(Out);
+	if (fclose(Out) != 0 || !written || rename(tmpname.data(), path.c_str()) != 0) {
+		unlink(tmpname.data());
+		return error(path, std::strerror(errno));
+	}
+	return true;
+}
+
+//-------------------------------------
+// Compiler Arguments
+//-------------------------------------
+// Outputs of a Compiler Invocation: the -o file, or else the .s file of each source input in the working directory
+// (none if no source is compiled). An invocation compiling sources to objects or executables is an error.
+bool getCompilerOutputs(const std::vector<std::string> &Args, std::vector<std::string> &Outputs) {
+	static const char *const SourceSuffixes[] = {".c", ".cc", ".cpp", ".cxx", ".C", ".i", ".ii", ".ll", ".bc"};
+	static const char *const ValueOptions[] = {"-I", "-D", "-U", "-x", "-MF", "-MT", "-MQ", "-include", "-isystem", "-idirafter",
+											   "-iquote", "-target", "-Xclang", "-mllvm", "-Xlinker", "-L", "-l"};
+	std::vector<std::string> Inputs;
+	bool assemble = false, preprocess = false;
+	for (size_t idx = 0; idx < Args.size(); ++idx) {
+		const std::string &Arg = Args[idx];
+		if (Arg == "-o" && idx + 1 < Args.size()) Outputs.push_back(Args[++idx]);
+		else if (Arg.compare(0, 2, "-o") == 0 && Arg.size() > 2)
+			Outputs.push_back(Arg.substr(2));
+		else if (Arg == "-S")
+			assemble = true;
+		else if (Arg == "-E" || Arg == "-M" || Arg == "-MM")
+			preprocess = true;
+		else if (std::find(std::begin(ValueOptions), std::end(ValueOptions), Arg) != std::end(ValueOptions))
+			++idx;
+		else if (Arg[0] != '-') {
+			for (const char *Suffix : SourceSuffixes)
+				if (hasSuffix(Arg, Suffix)) {
+					Inputs.push_back(Arg);
+					break;
+				}
+		}
+	}
+	if (preprocess || Inputs.empty()) {
+		Outputs.clear();
+		return true;
+	}
+	if (!assemble) return error(Outputs.empty() ? Inputs[0] : Outputs[0], "cca instructions are dropped as comments by the assembler (compile with -S)");
+	if (!Outputs.empty()) return true;
+	for (const std::string &Input : Inputs) {
+		std::string Base = Input.substr(Input.find_last_of('/') + 1);
+		Outputs.push_back(Base.substr(0, Base.find_last_of('.')) + ".s");
+	}
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	// Parse Arguments
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::string> Files;
+	for (int idx = 1; idx < argc; ++idx) {
+		std::string Arg = argv[idx];
+		if (Arg == "-j" && idx + 1 < argc) threads = std::max(1, std::atoi(argv[++idx]));
+		else if (Arg == "--compiler-args") {
+			std::vector<std::string> Outputs;
+			if (!getCompilerOutputs(std::vector<std::string>(argv + idx + 1, argv + argc), Outputs)) return 1;
+			Files.insert(Files.end(), Outputs.begin(), Outputs.end());
+			break;
+		} else
+			Files.push_back(Arg);
+	}
+
+	// Process the Files on a Thread Pool
+	std::atomic<size_t> next(0);
+	std::atomic<bool> failed(false);
+	auto worker = [&]() {
+		for (size_t idx = next++; idx < Files.size(); idx = next++)
+			if (!process(Files[idx])) failed = true;
+	};
+	std::vector<std::thread> Pool;
+	for (unsigned tidx = 1; tidx < std::min<size_t>(threads, Files.size()); ++tidx) Pool.emplace_back(worker);
+	worker();
+	for (auto &T : Pool) T.join();
+	return failed ? 1 : 0;
+}
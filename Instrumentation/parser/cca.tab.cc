@@ -1,5 +1,6 @@
 #include "Instrumentation/CCAPatternGraph.hpp"
 #include "parser.hpp"
+#include <sstream>
 
 namespace llvm {
 namespace cca {
@@ -1,8 +1,8 @@
-/* A Bison parser, made by GNU Bison 3.5.1.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison interface for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2020 Free Software Foundation,
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
    Inc.
 
    This program is free software: you can redistribute it and/or modify
@@ -16,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -31,8 +31,9 @@
    This special exception was added by the Free Software Foundation in
    version 2.2 of Bison.  */
 
-/* Undocumented macros, especially those whose name start with YY_,
-   are private implementation details.  Do not rely on them.  */
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
 
 #ifndef YY_YY_CCA_TAB_H_INCLUDED
 # define YY_YY_CCA_TAB_H_INCLUDED
@@ -44,28 +45,34 @@
 extern int yydebug;
 #endif
 
-/* Token type.  */
+/* Token kinds.  */
 #ifndef YYTOKENTYPE
 # define YYTOKENTYPE
   enum yytokentype
   {
-    REGISTER = 258,
-    NUMBER = 259,
-    ERROR = 260,
-    EQ = 261,
-    NE = 262,
-    LT = 263,
-    LE = 264,
-    GT = 265,
-    GE = 266
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    REGISTER = 258,                /* REGISTER  */
+    NUMBER = 259,                  /* NUMBER  */
+    ERROR = 260,                   /* ERROR  */
+    EQ = 261,                      /* EQ  */
+    NE = 262,                      /* NE  */
+    LT = 263,                      /* LT  */
+    LE = 264,                      /* LE  */
+    GT = 265,                      /* GT  */
+    GE = 266                       /* GE  */
   };
+  typedef enum yytokentype yytoken_kind_t;
 #endif
 
 /* Value type.  */
 
 
-extern YYSTYPE yylval;
 
-int yyparse (void);
+
+int yyparse (Scanner &scanner, CCAPatternGraph *&G);
+
 
 #endif /* !YY_YY_CCA_TAB_H_INCLUDED  */
@@ -2,10 +2,12 @@
 #include "Instrumentation/CCAPatternGraph.hpp"
 #include "parser.hpp"
 #include <vector>
-
-static CCAPatternGraph* _G = nullptr;
 %}
 
+%define api.pure full
+%lex-param {Scanner &scanner}
+%parse-param {Scanner &scanner} {CCAPatternGraph *&G}
+
 %token REGISTER NUMBER ERROR
 %token EQ NE LT LE GT GE 
 
@@ -17,7 +19,7 @@ static CCAPatternGraph* _G = nullptr;
 
 %%
 
-program :  NUMBER ':' assignment_list { _G = new CCAPatternGraph(std::atoi($1.text_.c_str()), $3); }
+program :  NUMBER ':' assignment_list { G = new CCAPatternGraph(std::atoi($1.text_.c_str()), $3); }
 		;
 
 assignment_list : assignment_list ';' assignment { $$ = $1; $$.push_back($3); }
@@ -55,16 +57,26 @@ expr3 : '(' expr0 ')' { $$ = $2; }
 %%
 
 // Internal Functions
-int yyerror(const char* s) { 
+int yylex(YYSTYPE *lvalp, Scanner &scanner) {
+	lvalp->tok = scanner.getToken();
+	return lvalp->tok;
+}
+
+int yyerror(Scanner &scanner, CCAPatternGraph *&G, const char* s) { 
 	std::cerr << "[PASS] Error in Parser : " << s << '\n';
-	std::cerr << "  - Last Token : " << yylval.tok.text_ << std::endl;
+	std::cerr << "  - Last Token : " << scanner.lastTok().text_ << std::endl;
 	return 0; 
 }
 
 // External Interfaces
+// Each call has its own scanner and parser state, so patterns may be parsed on many threads
 CCAPatternGraph *parsePatternStr(std::string patternStr) {
-	setPatternStr(patternStr);
-	_G = nullptr;
-	yyparse();
-	return _G;
+	std::istringstream patternStrSS(patternStr);
+	Scanner scanner(patternStrSS, std::cerr);
+	CCAPatternGraph *G = nullptr;
+	if (yyparse(scanner, G) != 0) {
+		delete G;
+		return nullptr;
+	}
+	return G;
 }
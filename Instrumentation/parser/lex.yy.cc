@@ -620,92 +620,92 @@ do_action:	/* This label is used only to access EOF actions. */
 case 1:
 YY_RULE_SETUP
 #line 25 "cca.lex"
-{ return yylval.tok = {':', ":"}; }
+{ return lastTok_ = {':', ":"}; }
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
 #line 26 "cca.lex"
-{ return yylval.tok = {';', ";"}; }
+{ return lastTok_ = {';', ";"}; }
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
 #line 27 "cca.lex"
-{ return yylval.tok = {'?', "?"}; }
+{ return lastTok_ = {'?', "?"}; }
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
 #line 28 "cca.lex"
-{ return yylval.tok = {'(', "("}; }
+{ return lastTok_ = {'(', "("}; }
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
 #line 29 "cca.lex"
-{ return yylval.tok = {')', ")"}; }
+{ return lastTok_ = {')', ")"}; }
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
 #line 30 "cca.lex"
-{ return yylval.tok = {'+', "+"}; }
+{ return lastTok_ = {'+', "+"}; }
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
 #line 31 "cca.lex"
-{ return yylval.tok = {'-', "-"}; }
+{ return lastTok_ = {'-', "-"}; }
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
 #line 32 "cca.lex"
-{ return yylval.tok = {'*', "*"}; }
+{ return lastTok_ = {'*', "*"}; }
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
 #line 33 "cca.lex"
-{ return yylval.tok = {'/', "/"}; }
+{ return lastTok_ = {'/', "/"}; }
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
 #line 34 "cca.lex"
-{ return yylval.tok = {'=', "="}; }
+{ return lastTok_ = {'=', "="}; }
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
 #line 35 "cca.lex"
-{ return yylval.tok = {EQ, "=="};}
+{ return lastTok_ = {EQ, "=="};}
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
 #line 36 "cca.lex"
-{ return yylval.tok = {NE, "!="};}
+{ return lastTok_ = {NE, "!="};}
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
 #line 37 "cca.lex"
-{ return yylval.tok = {LT, "<"};}
+{ return lastTok_ = {LT, "<"};}
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
 #line 38 "cca.lex"
-{ return yylval.tok = {LE, "<="};}
+{ return lastTok_ = {LE, "<="};}
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
 #line 39 "cca.lex"
-{ return yylval.tok = {GT, ">"};}
+{ return lastTok_ = {GT, ">"};}
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
 #line 40 "cca.lex"
-{ return yylval.tok = {GE, ">="};}
+{ return lastTok_ = {GE, ">="};}
 	YY_BREAK
 case 17:
 YY_RULE_SETUP
 #line 41 "cca.lex"
-{ return yylval.tok = {REGISTER, std::string(yytext)}; }
+{ return lastTok_ = {REGISTER, std::string(yytext)}; }
 	YY_BREAK
 case 18:
 YY_RULE_SETUP
 #line 42 "cca.lex"
-{ return yylval.tok = {NUMBER, std::string(yytext)}; }
+{ return lastTok_ = {NUMBER, std::string(yytext)}; }
 	YY_BREAK
 case 19:
 YY_RULE_SETUP
@@ -715,7 +715,7 @@ YY_RULE_SETUP
 case 20:
 YY_RULE_SETUP
 #line 44 "cca.lex"
-{ return yylval.tok = {ERROR, std::string(yytext)}; }
+{ return lastTok_ = {ERROR, std::string(yytext)}; }
 	YY_BREAK
 case 21:
 YY_RULE_SETUP
@@ -1686,31 +1686,3 @@ void yyfree (void * ptr )
 #define YYTABLES_NAME "yytables"
 
 #line 46 "cca.lex"
-
-
-namespace llvm {
-namespace cca {
-namespace parser {
-
-static std::istringstream _patternStrSS;
-static Scanner _scanner(_patternStrSS, std::cerr);
-static Token _lastTok(ERROR);
-
-void setPatternStr(std::string str) {
-	_patternStrSS.str(str);
-	_patternStrSS.clear();
-}
-
-int yylex(void) { 
-	_lastTok = _scanner.getToken(); 
-	return _lastTok;
-}
-
-Token lastTok(void) {
-	return _lastTok;
-}
-
-} // namespace parser
-} // namespace cca
-} // namespace llvm
-
@@ -42,17 +42,19 @@ struct _YYSTYPE {
 typedef struct _YYSTYPE YYSTYPE;
 #define YYSTYPE_IS_DECLARED 1
 
-// Scanner
+// Scanner (one per parse)
 class Scanner : public yyFlexLexer {
+  private:
+	Token lastTok_;
+
   public:
-	Scanner(std::istream &is, std::ostream &os) : yyFlexLexer(is, os) {}
+	Scanner(std::istream &is, std::ostream &os) : yyFlexLexer(is, os), lastTok_(0) {}
 	Token getToken(void);
+	const Token &lastTok(void) const { return lastTok_; }
 };
 
-void setPatternStr(std::string patternStr);
-int yylex(void);
-int yyerror(const char *s);
-Token lastTok(void);
+int yylex(YYSTYPE *lvalp, Scanner &scanner);
+int yyerror(Scanner &scanner, CCAPatternGraph *&G, const char *s);
 
 }; // namespace parser
 }; // namespace cca
@@ -0,0 +1,53 @@
+#!/bin/bash
+# Speedup of the parallel search: generates a module of many functions, runs the cca-universal pass on it
+# with each number of threads, and checks that the output is the same as with one thread.
+#   usage: cca_threads_bench.sh [functions] [threads...]
+#   env:   OPT (opt binary), PLUGIN (the pass plugin), CCA_RULE_LIBRARY (the rules), CCA_ARGS (more opt args)
+
+SCRIPT_DIR="$(readlink -f "$(dirname "${BASH_SOURCE[0]:-${(%):-%x}}")")"
+OPT=${OPT:-opt}
+PLUGIN=${PLUGIN:-$SCRIPT_DIR/build/Instrumentation/libPIMCCALLVMInstrumentation.so}
+FUNCS=${1:-500}
+shift
+THREADS=${@:-1 2 4 8}
+WORK=$(mktemp -d)
+trap "rm -rf $WORK" EXIT
+
+# Functions of straight-line add/sub/mul/select chains, with loads and stores of a pointer argument
+awk -v n=$FUNCS 'BEGIN {
+	srand(7);
+	split("add add add sub mul load sel", ops, " ");
+	for (f = 0; f < n; ++f) {
+		printf "define i32 @k%d(i32* %%p, i32 %%a0, i32 %%a1, i32 %%a2, i32 %%a3, i32 %%a4) {\nentry:\n", f;
+		nv = 0;
+		for (v = 0; v < 5; ++v) vals[nv++] = "%a" v;
+		len = 8 * (4 + int(rand() * 9));
+		for (c = 0; c < len; ++c) {
+			op = ops[1 + int(rand() * 7)];
+			lo = nv > 12 ? nv - 12 : 0;
+			x = vals[lo + int(rand() * (nv - lo))];
+			do y = vals[lo + int(rand() * (nv - lo))]; while (y == x);
+			if (op == "load") {
+				printf "  %%g%d = getelementptr i32, i32* %%p, i32 %d\n  %%v%d = load i32, i32* %%g%d\n", c, int(rand() * 65), c, c;
+			} else if (op == "sel") {
+				printf "  %%c%d = icmp sgt i32 %s, %s\n  %%v%d = select i1 %%c%d, i32 %s, i32 %s\n", c, x, y, c, c, x, y;
+			} else {
+				printf "  %%v%d = %s i32 %s, %s\n", c, op, x, y;
+			}
+			vals[nv++] = "%v" c;
+			if (rand() < 0.1) printf "  store i32 %%v%d, i32* %%p\n", c;
+		}
+		printf "  ret i32 %s\n}\n", vals[nv - 1];
+	}
+}' > $WORK/module.ll
+
+echo "functions = $FUNCS, cores = $(nproc)"
+for t in $THREADS
+do
+	start=$(date +%s.%N)
+	$OPT -load $PLUGIN -load-pass-plugin $PLUGIN -passes=cca-universal -cca-threads=$t $CCA_ARGS -S $WORK/module.ll -o $WORK/out.$t.ll > /dev/null || exit 1
+	end=$(date +%s.%N)
+	[ -f $WORK/out.1.ll ] || cp $WORK/out.$t.ll $WORK/out.1.ll
+	cmp -s $WORK/out.1.ll $WORK/out.$t.ll && same=same || same=DIFFERENT
+	echo "threads = $t: $(awk "BEGIN { printf \"%.3f\", $end - $start }") s ($same output as 1 thread)"
+done